@@ -10,52 +10,114 @@ You should include it in a single .cpp or .c file.
 The instructions (such as required compiler flags) and usage guidance are found at https://antithesis.com/docs/using_antithesis/sdk/cpp/overview/.
 */
 
+// Strict ISO C modes, such as -std=c99, hide the POSIX and BSD flags used below unless they are asked for
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
 #include <unistd.h>
 #include <string.h>
 #include <dlfcn.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #ifndef __cplusplus
 #include <stdbool.h>
 #include <stddef.h>
 #endif
 
+// In case the system headers were already included in a strict mode
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
 // If the libvoidstar(determ) library is present, 
 // pass thru trace_pc_guard related callbacks to it
 typedef void (*trace_pc_guard_init_fn)(uint32_t *start, uint32_t *stop);
 typedef void (*trace_pc_guard_fn)(uint32_t *guard, uint64_t edge);
+// Callbacks for -fsanitize-coverage=inline-8bit-counters,pc-table, used when libvoidstar provides them
+typedef void (*counters_init_fn)(char *start, char *end);
+typedef void (*pcs_init_fn)(const uintptr_t *begin, const uintptr_t *end);
+
+// Callbacks for -fsanitize-coverage=trace-cmp, used when libvoidstar provides all of them
+typedef void (*trace_cmp1_fn)(uint8_t arg1, uint8_t arg2);
+typedef void (*trace_cmp2_fn)(uint16_t arg1, uint16_t arg2);
+typedef void (*trace_cmp4_fn)(uint32_t arg1, uint32_t arg2);
+typedef void (*trace_cmp8_fn)(uint64_t arg1, uint64_t arg2);
+typedef void (*trace_switch_fn)(uint64_t value, uint64_t *cases);
 
 static trace_pc_guard_init_fn trace_pc_guard_init = NULL;
 static trace_pc_guard_fn trace_pc_guard = NULL;
+static counters_init_fn counters_init = NULL;
+static pcs_init_fn pcs_init = NULL;
 static bool did_check_libvoidstar = false;
 static bool has_libvoidstar = false;
+static bool has_libvoidstar_counters = false;
+static trace_cmp1_fn trace_cmp1 = NULL;
+static trace_cmp2_fn trace_cmp2 = NULL;
+static trace_cmp4_fn trace_cmp4 = NULL;
+static trace_cmp8_fn trace_cmp8 = NULL;
+static trace_cmp1_fn trace_const_cmp1 = NULL;
+static trace_cmp2_fn trace_const_cmp2 = NULL;
+static trace_cmp4_fn trace_const_cmp4 = NULL;
+static trace_cmp8_fn trace_const_cmp8 = NULL;
+static trace_switch_fn trace_switch = NULL;
+static bool has_libvoidstar_comparisons = false;
 
 static __attribute__((no_sanitize("coverage"))) void debug_message_out(const char *msg) {
   (void)printf("%s\n", msg);
   return;
 }
 
-extern
-#ifdef __cplusplus
-    "C"
-#endif
-__attribute__((no_sanitize("coverage"))) void antithesis_load_libvoidstar() {
+// Defined below, with the local coverage counters and comparisons
+static void local_coverage_select(void);
+static void comparisons_select_consumer(void);
+
+static __attribute__((no_sanitize("coverage"))) void open_libvoidstar(void) {
 #ifdef __cplusplus
     constexpr
 #endif
     const char* LIB_PATH = "/usr/lib/libvoidstar.so";
 
-    if (did_check_libvoidstar) {
-      return;
-    }
     debug_message_out("TRYING TO LOAD libvoidstar");
-    did_check_libvoidstar = true;
-    void* shared_lib = dlopen(LIB_PATH, RTLD_NOW);
+    // ANTITHESIS_SDK_LIB_PATH loads a different library, as it does for antithesis_sdk.h
+    const char* lib_path = getenv("ANTITHESIS_SDK_LIB_PATH");
+    void* shared_lib = dlopen((lib_path && lib_path[0]) ? lib_path : LIB_PATH, RTLD_NOW);
     if (!shared_lib) {
         debug_message_out("Can not load the Antithesis native library");
         return;
     }
 
+    // Inline counters are optional; without them, the counter regions are kept locally
+    void* counters_init_sym = dlsym(shared_lib, "__sanitizer_cov_8bit_counters_init");
+    void* pcs_init_sym = dlsym(shared_lib, "__sanitizer_cov_pcs_init");
+    if (counters_init_sym && pcs_init_sym) {
+        counters_init = (counters_init_fn)(counters_init_sym);
+        pcs_init = (pcs_init_fn)(pcs_init_sym);
+        has_libvoidstar_counters = true;
+    }
+
+    // Comparison tracing is optional too; without it, operands are only kept locally if asked for
+    trace_cmp1 = (trace_cmp1_fn)(dlsym(shared_lib, "__sanitizer_cov_trace_cmp1"));
+    trace_cmp2 = (trace_cmp2_fn)(dlsym(shared_lib, "__sanitizer_cov_trace_cmp2"));
+    trace_cmp4 = (trace_cmp4_fn)(dlsym(shared_lib, "__sanitizer_cov_trace_cmp4"));
+    trace_cmp8 = (trace_cmp8_fn)(dlsym(shared_lib, "__sanitizer_cov_trace_cmp8"));
+    trace_const_cmp1 = (trace_cmp1_fn)(dlsym(shared_lib, "__sanitizer_cov_trace_const_cmp1"));
+    trace_const_cmp2 = (trace_cmp2_fn)(dlsym(shared_lib, "__sanitizer_cov_trace_const_cmp2"));
+    trace_const_cmp4 = (trace_cmp4_fn)(dlsym(shared_lib, "__sanitizer_cov_trace_const_cmp4"));
+    trace_const_cmp8 = (trace_cmp8_fn)(dlsym(shared_lib, "__sanitizer_cov_trace_const_cmp8"));
+    trace_switch = (trace_switch_fn)(dlsym(shared_lib, "__sanitizer_cov_trace_switch"));
+    has_libvoidstar_comparisons = trace_cmp1 && trace_cmp2 && trace_cmp4 && trace_cmp8 &&
+        trace_const_cmp1 && trace_const_cmp2 && trace_const_cmp4 && trace_const_cmp8 && trace_switch;
+
     void* trace_pc_guard_init_sym = dlsym(shared_lib, "__sanitizer_cov_trace_pc_guard_init");
     if (!trace_pc_guard_init_sym) {
         debug_message_out("Can not forward calls to libvoidstar for __sanitizer_cov_trace_pc_guard_init");
@@ -74,6 +136,282 @@ __attribute__((no_sanitize("coverage"))) void antithesis_load_libvoidstar() {
     debug_message_out("LOADED libvoidstar");
 }
 
+// Loads libvoidstar, if it is present, and decides what is counted locally instead. The coverage hooks
+// call it the first time they run; calling it earlier is harmless.
+extern
+#ifdef __cplusplus
+    "C"
+#endif
+__attribute__((no_sanitize("coverage"))) void antithesis_load_libvoidstar() {
+    if (did_check_libvoidstar) {
+      return;
+    }
+    did_check_libvoidstar = true;
+    open_libvoidstar();
+    local_coverage_select();
+    comparisons_select_consumer();
+}
+
+// Without libvoidstar, coverage can be counted in-process instead, by naming a file in
+// ANTITHESIS_SDK_LOCAL_COVERAGE. Otherwise each guard is zeroed the first time its edge runs, so that an
+// instrumented build pays for at most one call per edge. Each edge guard is given an id when its
+// module is initialized, and every execution of the edge increments the byte counter at that id. The
+// counters wrap, and concurrent increments may be lost; both are acceptable for a coverage signal.
+// Counter 0 is a sink shared by guards that have no id (not yet initialized, or past the capacity).
+// Modules built with inline 8-bit counters already own their counters; when coverage is counted locally,
+// each such region is recorded, along with its PC table, and numbered after the guard ids when exported.
+//
+// The counters are written to the ANTITHESIS_SDK_LOCAL_COVERAGE file at exit. Name a file
+// under /dev/shm to export them to a shared-memory segment instead. The file holds, in native byte order:
+//   char     magic[8]              "ANTCOV01"
+//   uint32_t module_count
+//   uint32_t reserved             0
+//   uint64_t counter_count         including the sink at id 0
+//   struct { uint64_t first_id; uint64_t edge_count; } modules[module_count]
+//   uint8_t  counters[counter_count]  guard counters, then each inline counter region in load order
+#ifndef ANTITHESIS_LOCAL_COVERAGE_CAPACITY
+#define ANTITHESIS_LOCAL_COVERAGE_CAPACITY (1u << 24)
+#endif
+#ifndef ANTITHESIS_LOCAL_COVERAGE_MAX_MODULES
+#define ANTITHESIS_LOCAL_COVERAGE_MAX_MODULES 256
+#endif
+
+typedef struct {
+    uint64_t first_id;
+    uint64_t edge_count;
+} antithesis_local_coverage_module;
+
+// A module's inline 8-bit counters. `pcs` holds a (PC, flags) pair per counter, or is NULL when the
+// module was built without pc-table.
+typedef struct {
+    uint8_t *counters;
+    size_t count;
+    const uintptr_t *pcs;
+} antithesis_local_coverage_region;
+
+static uint8_t local_coverage_sink[1];
+// Points at the sink until the first module is initialized, so that guards can always be counted
+static uint8_t *local_coverage_counters = local_coverage_sink;
+static uint32_t local_coverage_next_id = 1;
+static uint32_t local_coverage_module_count = 0;
+static antithesis_local_coverage_module local_coverage_modules[ANTITHESIS_LOCAL_COVERAGE_MAX_MODULES];
+static uint32_t local_coverage_region_count = 0;
+static antithesis_local_coverage_region local_coverage_regions[ANTITHESIS_LOCAL_COVERAGE_MAX_MODULES];
+static bool local_coverage_export_registered = false;
+static bool local_coverage_enabled = false;
+
+static __attribute__((no_sanitize("coverage"))) void local_coverage_write_fully(int fd, const void *data, size_t length) {
+    const char *bytes = (const char *)data;
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written <= 0) {
+            debug_message_out("Can not write local coverage");
+            return;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+}
+
+static __attribute__((no_sanitize("coverage"))) void local_coverage_export(void) {
+    const char *path = getenv("ANTITHESIS_SDK_LOCAL_COVERAGE");
+    if (!path || !*path) {
+        return;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        debug_message_out("Can not open the local coverage file");
+        return;
+    }
+    uint64_t counter_count = local_coverage_next_id;
+    for (uint32_t i = 0; i < local_coverage_region_count; i++) {
+        counter_count += local_coverage_regions[i].count;
+    }
+    struct {
+        char magic[8];
+        uint32_t module_count;
+        uint32_t reserved;
+        uint64_t counter_count;
+    } header = { {'A', 'N', 'T', 'C', 'O', 'V', '0', '1'}, local_coverage_module_count + local_coverage_region_count, 0, counter_count };
+    local_coverage_write_fully(fd, &header, sizeof(header));
+    local_coverage_write_fully(fd, local_coverage_modules, local_coverage_module_count * sizeof(antithesis_local_coverage_module));
+    uint64_t first_id = local_coverage_next_id;
+    for (uint32_t i = 0; i < local_coverage_region_count; i++) {
+        antithesis_local_coverage_module module = { first_id, local_coverage_regions[i].count };
+        local_coverage_write_fully(fd, &module, sizeof(module));
+        first_id += module.edge_count;
+    }
+    local_coverage_write_fully(fd, local_coverage_counters, local_coverage_next_id);
+    for (uint32_t i = 0; i < local_coverage_region_count; i++) {
+        local_coverage_write_fully(fd, local_coverage_regions[i].counters, local_coverage_regions[i].count);
+    }
+    (void)close(fd);
+}
+
+static __attribute__((no_sanitize("coverage"))) void local_coverage_register_export(void) {
+    if (!local_coverage_export_registered) {
+        local_coverage_export_registered = true;
+        (void)atexit(local_coverage_export);
+    }
+}
+
+// Decides whether coverage is counted locally. Called once, after the attempt to load libvoidstar.
+static __attribute__((no_sanitize("coverage"))) void local_coverage_select(void) {
+    const char *path = getenv("ANTITHESIS_SDK_LOCAL_COVERAGE");
+    local_coverage_enabled = !has_libvoidstar && path && *path;
+}
+
+// Returns zeroed memory that is only backed once touched, or NULL.
+static __attribute__((no_sanitize("coverage"))) void *local_coverage_allocate(size_t size) {
+#ifdef MAP_ANONYMOUS
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+#else
+    return calloc(1, size);
+#endif
+}
+
+static __attribute__((no_sanitize("coverage"))) void local_coverage_init(uint32_t *start, uint32_t *stop) {
+    if (!local_coverage_enabled || start == stop || *start) {
+        return;
+    }
+    if (local_coverage_counters == local_coverage_sink) {
+        // Reserve room for every id up front, so the counters never move
+        void *counters = local_coverage_allocate(ANTITHESIS_LOCAL_COVERAGE_CAPACITY);
+        if (counters == NULL) {
+            debug_message_out("Can not allocate local coverage counters");
+            return;
+        }
+        local_coverage_counters = (uint8_t *)counters;
+        local_coverage_register_export();
+    }
+
+    const uint32_t first_id = local_coverage_next_id;
+    for (uint32_t *guard = start; guard < stop; guard++) {
+        *guard = local_coverage_next_id < ANTITHESIS_LOCAL_COVERAGE_CAPACITY ? local_coverage_next_id++ : 0;
+    }
+    if (local_coverage_module_count < ANTITHESIS_LOCAL_COVERAGE_MAX_MODULES) {
+        antithesis_local_coverage_module module = { first_id, local_coverage_next_id - first_id };
+        local_coverage_modules[local_coverage_module_count++] = module;
+    }
+}
+
+// Returns the local coverage counters, indexed by guard id, and stores their number in `count`.
+// Returns NULL when coverage is being forwarded to libvoidstar, or not counted locally.
+extern
+#ifdef __cplusplus
+    "C"
+#endif
+__attribute__((no_sanitize("coverage"))) const uint8_t *antithesis_local_coverage(size_t *count) {
+    if (!local_coverage_enabled) {
+        *count = 0;
+        return NULL;
+    }
+    *count = local_coverage_next_id;
+    return local_coverage_counters;
+}
+
+// Returns the inline 8-bit counter regions kept locally, and stores their number in `count`.
+extern
+#ifdef __cplusplus
+    "C"
+#endif
+__attribute__((no_sanitize("coverage"))) const antithesis_local_coverage_region *antithesis_local_coverage_regions(size_t *count) {
+    *count = local_coverage_region_count;
+    return local_coverage_regions;
+}
+
+// Comparison operands are either forwarded to libvoidstar, recorded locally, or (by default, when
+// neither is available) ignored right away. Local recording is enabled by naming a file in
+// ANTITHESIS_SDK_LOCAL_COMPARISONS, to which the table is written at exit.
+//
+// The local table has a fixed number of entries, each holding the most recent operands seen at the
+// call sites that hash to it. Entries are updated with relaxed atomics and no locks, so an entry shared
+// by two call sites, or read while being updated, may mix their operands; like the coverage counters,
+// it is a guidance signal rather than an exact record. The file holds, in native byte order:
+//   char     magic[8]              "ANTCMP01"
+//   uint32_t entry_count
+//   uint32_t operand_count         operand pairs per entry
+//   antithesis_local_comparison entries[entry_count]
+#ifndef ANTITHESIS_LOCAL_COMPARISONS_CAPACITY
+#define ANTITHESIS_LOCAL_COMPARISONS_CAPACITY 4096
+#endif
+#define ANTITHESIS_LOCAL_COMPARISON_OPERANDS 4
+
+// `kind` is the operand size in bytes, combined with the flags below
+#define ANTITHESIS_COMPARISON_CONST 0x10
+#define ANTITHESIS_COMPARISON_SWITCH 0x20
+
+typedef struct {
+    uint64_t pc;
+    uint32_t kind;
+    // Total number of comparisons recorded; the latest operands are at (count - 1) % operand count
+    uint32_t count;
+    uint64_t operands[ANTITHESIS_LOCAL_COMPARISON_OPERANDS][2];
+} antithesis_local_comparison;
+
+enum { COMPARISONS_NONE, COMPARISONS_FORWARD, COMPARISONS_LOCAL };
+static int comparison_consumer = COMPARISONS_NONE;
+static antithesis_local_comparison *local_comparisons = NULL;
+
+static __attribute__((no_sanitize("coverage"))) void local_comparisons_export(void) {
+    const char *path = getenv("ANTITHESIS_SDK_LOCAL_COMPARISONS");
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        debug_message_out("Can not open the local comparisons file");
+        return;
+    }
+    struct {
+        char magic[8];
+        uint32_t entry_count;
+        uint32_t operand_count;
+    } header = { {'A', 'N', 'T', 'C', 'M', 'P', '0', '1'}, ANTITHESIS_LOCAL_COMPARISONS_CAPACITY, ANTITHESIS_LOCAL_COMPARISON_OPERANDS };
+    local_coverage_write_fully(fd, &header, sizeof(header));
+    local_coverage_write_fully(fd, local_comparisons, ANTITHESIS_LOCAL_COMPARISONS_CAPACITY * sizeof(antithesis_local_comparison));
+    (void)close(fd);
+}
+
+// Chooses where comparison operands go. Called once, after the attempt to load libvoidstar.
+static __attribute__((no_sanitize("coverage"))) void comparisons_select_consumer(void) {
+    if (has_libvoidstar_comparisons) {
+        comparison_consumer = COMPARISONS_FORWARD;
+        return;
+    }
+    const char *path = getenv("ANTITHESIS_SDK_LOCAL_COMPARISONS");
+    if (!path || !*path) {
+        return;
+    }
+    void *table = local_coverage_allocate(ANTITHESIS_LOCAL_COMPARISONS_CAPACITY * sizeof(antithesis_local_comparison));
+    if (table == NULL) {
+        debug_message_out("Can not allocate the local comparisons table");
+        return;
+    }
+    local_comparisons = (antithesis_local_comparison *)table;
+    comparison_consumer = COMPARISONS_LOCAL;
+    (void)atexit(local_comparisons_export);
+}
+
+static __attribute__((no_sanitize("coverage"))) void local_comparison_record(uintptr_t pc, uint64_t arg1, uint64_t arg2, uint32_t kind) {
+    const uint64_t hash = (uint64_t)pc * 0x9E3779B97F4A7C15ull;
+    antithesis_local_comparison *entry = &local_comparisons[(hash >> 32) % ANTITHESIS_LOCAL_COMPARISONS_CAPACITY];
+    const uint32_t slot = __atomic_fetch_add(&entry->count, 1, __ATOMIC_RELAXED) % ANTITHESIS_LOCAL_COMPARISON_OPERANDS;
+    __atomic_store_n(&entry->operands[slot][0], arg1, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->operands[slot][1], arg2, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->kind, kind, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->pc, (uint64_t)pc, __ATOMIC_RELAXED);
+}
+
+// Returns the local comparisons table, and stores its number of entries in `count`.
+// Returns NULL when comparison operands are not being recorded locally.
+extern
+#ifdef __cplusplus
+    "C"
+#endif
+__attribute__((no_sanitize("coverage"))) const antithesis_local_comparison *antithesis_local_comparisons(size_t *count) {
+    *count = local_comparisons ? ANTITHESIS_LOCAL_COMPARISONS_CAPACITY : 0;
+    return local_comparisons;
+}
+
 // The following symbols are indeed reserved identifiers, since we're implementing functions defined
 // in the compiler runtime. Not clear how to get Clang on board with that besides narrowly suppressing
 // the warning in this case. The sample code on the CoverageSanitizer documentation page fails this 
@@ -91,6 +429,8 @@ void __sanitizer_cov_trace_pc_guard_init(uint32_t *start, uint32_t *stop) {
     }
     if (has_libvoidstar) {
         trace_pc_guard_init(start, stop);
+    } else {
+        local_coverage_init(start, stop);
     }
     return;
 }
@@ -103,11 +443,124 @@ void __sanitizer_cov_trace_pc_guard( uint32_t *guard ) {
     if (has_libvoidstar) {
         uint64_t edge = (uint64_t)(__builtin_return_address(0));
         trace_pc_guard(guard, edge);
-    } else {
-        if (guard) {
-          *guard = 0;
-        }
+    } else if (local_coverage_enabled) {
+        local_coverage_counters[*guard]++;
+    } else if (guard) {
+        *guard = 0;
     }
     return;
 }
+
+// With inline 8-bit counters the compiler increments each edge's counter directly, so there is no
+// per-edge callback; the counters of each module are only handed over once, when it is loaded.
+extern
+#ifdef __cplusplus
+    "C"
+#endif
+__attribute__((no_sanitize("coverage"))) void __sanitizer_cov_8bit_counters_init(char *start, char *end) {
+    if (!did_check_libvoidstar) {
+        antithesis_load_libvoidstar();
+    }
+    if (has_libvoidstar_counters) {
+        counters_init(start, end);
+        return;
+    }
+    if (!local_coverage_enabled || start == end) {
+        return;
+    }
+    for (uint32_t i = 0; i < local_coverage_region_count; i++) {
+        if (local_coverage_regions[i].counters == (uint8_t *)start) {
+            return;
+        }
+    }
+    if (local_coverage_region_count == ANTITHESIS_LOCAL_COVERAGE_MAX_MODULES) {
+        debug_message_out("Too many modules for local coverage");
+        return;
+    }
+    antithesis_local_coverage_region region = { (uint8_t *)start, (size_t)(end - start), NULL };
+    local_coverage_regions[local_coverage_region_count++] = region;
+    local_coverage_register_export();
+}
+
+// Called after __sanitizer_cov_8bit_counters_init for the same module, with one (PC, flags) pair per counter.
+extern
+#ifdef __cplusplus
+    "C"
+#endif
+__attribute__((no_sanitize("coverage"))) void __sanitizer_cov_pcs_init(const uintptr_t *begin, const uintptr_t *end) {
+    if (!did_check_libvoidstar) {
+        antithesis_load_libvoidstar();
+    }
+    if (has_libvoidstar_counters) {
+        pcs_init(begin, end);
+        return;
+    }
+    if (!local_coverage_enabled) {
+        return;
+    }
+    const size_t count = (size_t)(end - begin) / 2;
+    for (uint32_t i = local_coverage_region_count; i > 0; i--) {
+        antithesis_local_coverage_region *region = &local_coverage_regions[i - 1];
+        if (region->pcs == NULL && region->count == count) {
+            region->pcs = begin;
+            return;
+        }
+    }
+}
+
+// Comparison hooks for -fsanitize-coverage=trace-cmp. `const` variants are used when the first
+// operand is a compile-time constant.
+#ifdef __cplusplus
+#define ANTITHESIS_EXTERN_C extern "C"
+#else
+#define ANTITHESIS_EXTERN_C extern
+#endif
+#define ANTITHESIS_COMPARISON_HOOK(name, type, kind) \
+    ANTITHESIS_EXTERN_C __attribute__((no_sanitize("coverage"))) void __sanitizer_cov_##name(type arg1, type arg2) { \
+        if (__builtin_expect(comparison_consumer == COMPARISONS_NONE, 1)) { \
+            return; \
+        } \
+        if (comparison_consumer == COMPARISONS_FORWARD) { \
+            name(arg1, arg2); \
+            return; \
+        } \
+        local_comparison_record((uintptr_t)__builtin_return_address(0), arg1, arg2, kind); \
+    }
+
+ANTITHESIS_COMPARISON_HOOK(trace_cmp1, uint8_t, 1)
+ANTITHESIS_COMPARISON_HOOK(trace_cmp2, uint16_t, 2)
+ANTITHESIS_COMPARISON_HOOK(trace_cmp4, uint32_t, 4)
+ANTITHESIS_COMPARISON_HOOK(trace_cmp8, uint64_t, 8)
+ANTITHESIS_COMPARISON_HOOK(trace_const_cmp1, uint8_t, 1 | ANTITHESIS_COMPARISON_CONST)
+ANTITHESIS_COMPARISON_HOOK(trace_const_cmp2, uint16_t, 2 | ANTITHESIS_COMPARISON_CONST)
+ANTITHESIS_COMPARISON_HOOK(trace_const_cmp4, uint32_t, 4 | ANTITHESIS_COMPARISON_CONST)
+ANTITHESIS_COMPARISON_HOOK(trace_const_cmp8, uint64_t, 8 | ANTITHESIS_COMPARISON_CONST)
+#undef ANTITHESIS_COMPARISON_HOOK
+
+// `cases` holds the number of cases, the operand width in bits, then the case values. Locally, the
+// value is recorded against the case nearest to it, which is the one most worth steering towards.
+ANTITHESIS_EXTERN_C __attribute__((no_sanitize("coverage"))) void __sanitizer_cov_trace_switch(uint64_t value, uint64_t *cases) {
+    if (__builtin_expect(comparison_consumer == COMPARISONS_NONE, 1)) {
+        return;
+    }
+    if (comparison_consumer == COMPARISONS_FORWARD) {
+        trace_switch(value, cases);
+        return;
+    }
+    if (cases[0] == 0) {
+        return;
+    }
+    uint64_t nearest = cases[2];
+    for (uint64_t i = 1; i < cases[0]; i++) {
+        const uint64_t candidate = cases[2 + i];
+        const uint64_t distance = candidate > value ? candidate - value : value - candidate;
+        const uint64_t nearest_distance = nearest > value ? nearest - value : value - nearest;
+        if (distance < nearest_distance) {
+            nearest = candidate;
+        }
+    }
+    local_comparison_record((uintptr_t)__builtin_return_address(0), value, nearest,
+        (uint32_t)(cases[1] / 8) | ANTITHESIS_COMPARISON_SWITCH);
+}
+#undef ANTITHESIS_EXTERN_C
 #pragma clang diagnostic pop
@@ -35,18 +35,101 @@
 
 #include <cstdint>
 #include <string>
-#include <map>
-#include <set>
+#include <string_view>
 #include <variant>
 #include <vector>
 #include <utility>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
 
 namespace antithesis {
     inline const char* SDK_VERSION = "0.4.5";
     inline const char* PROTOCOL_VERSION = "1.1.0";
 
     struct JSON; struct JSONArray;
-    typedef std::variant<JSON, std::nullptr_t, std::string, bool, char, int, uint64_t, float, double, const char*, JSONArray> JSONValue;
+
+    // Holds a nested JSON object inside a JSONValue. JSON keeps its fields inline, so one JSON
+    // cannot contain another directly. A default-constructed JSONBox is an empty object and allocates nothing.
+    class JSONBox {
+    public:
+        JSONBox() {}
+        JSONBox(const JSON& json);
+        JSONBox(JSON&& json);
+        JSONBox(const JSONBox& other);
+        JSONBox(JSONBox&& other) noexcept : object(other.object) { other.object = nullptr; }
+        JSONBox& operator=(JSONBox other) noexcept { std::swap(object, other.object); return *this; }
+        ~JSONBox();
+
+        const JSON& get() const;
+        operator const JSON&() const { return get(); }
+
+    private:
+        JSON* object = nullptr;
+    };
+
+#if defined(__cpp_lib_span)
+    // A non-owning view of an array of numbers or bools, serialized as a JSON array straight from the
+    // caller's memory. As with `const char*` and `std::string_view` values, the memory has to stay valid
+    // until the details are emitted, which assertions do before they return.
+    class JSONSpan {
+    public:
+        enum ElementType : uint8_t {
+            BOOL, CHAR, SIGNED_CHAR, UNSIGNED_CHAR, SHORT, UNSIGNED_SHORT, INT, UNSIGNED_INT,
+            LONG, UNSIGNED_LONG, LONG_LONG, UNSIGNED_LONG_LONG, FLOAT, DOUBLE
+        };
+
+        template <typename T>
+        static constexpr bool is_element_v =
+            std::is_same_v<T, bool> || std::is_same_v<T, char> || std::is_same_v<T, signed char> || std::is_same_v<T, unsigned char> ||
+            std::is_same_v<T, short> || std::is_same_v<T, unsigned short> || std::is_same_v<T, int> || std::is_same_v<T, unsigned int> ||
+            std::is_same_v<T, long> || std::is_same_v<T, unsigned long> || std::is_same_v<T, long long> || std::is_same_v<T, unsigned long long> ||
+            std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+        template <typename T, size_t Extent, typename std::enable_if<is_element_v<std::remove_cv_t<T>>, bool>::type = true>
+        JSONSpan(std::span<T, Extent> elements) :
+            data(elements.data()), count(elements.size()), type(element_type_of<std::remove_cv_t<T>>()) {}
+
+        ElementType element_type() const { return type; }
+        size_t size() const { return count; }
+
+        // The elements, which must be of the type named by `element_type()`
+        template <typename T>
+        const T* elements() const { return static_cast<const T*>(data); }
+
+    private:
+        const void* data;
+        size_t count;
+        ElementType type;
+
+        template <typename T>
+        static constexpr ElementType element_type_of() {
+            if constexpr (std::is_same_v<T, bool>) return BOOL;
+            else if constexpr (std::is_same_v<T, char>) return CHAR;
+            else if constexpr (std::is_same_v<T, signed char>) return SIGNED_CHAR;
+            else if constexpr (std::is_same_v<T, unsigned char>) return UNSIGNED_CHAR;
+            else if constexpr (std::is_same_v<T, short>) return SHORT;
+            else if constexpr (std::is_same_v<T, unsigned short>) return UNSIGNED_SHORT;
+            else if constexpr (std::is_same_v<T, int>) return INT;
+            else if constexpr (std::is_same_v<T, unsigned int>) return UNSIGNED_INT;
+            else if constexpr (std::is_same_v<T, long>) return LONG;
+            else if constexpr (std::is_same_v<T, unsigned long>) return UNSIGNED_LONG;
+            else if constexpr (std::is_same_v<T, long long>) return LONG_LONG;
+            else if constexpr (std::is_same_v<T, unsigned long long>) return UNSIGNED_LONG_LONG;
+            else if constexpr (std::is_same_v<T, float>) return FLOAT;
+            else return DOUBLE;
+        }
+    };
+
+    typedef std::variant<JSONBox, std::nullptr_t, std::string, bool, char, int, uint64_t, float, double, const char*, JSONArray,
+        std::string_view, int64_t, uint32_t, int16_t, JSONSpan> JSONValue;
+#else
+    typedef std::variant<JSONBox, std::nullptr_t, std::string, bool, char, int, uint64_t, float, double, const char*, JSONArray,
+        std::string_view, int64_t, uint32_t, int16_t> JSONValue;
+#endif
 
     struct JSONArray : std::vector<JSONValue> {
         using std::vector<JSONValue>::vector;
@@ -55,15 +138,272 @@ namespace antithesis {
         JSONArray(std::vector<T> vals) : std::vector<JSONValue>(vals.begin(), vals.end()) {}
     };
 
-    struct JSON : std::map<std::string, JSONValue> {
-        JSON() : std::map<std::string, JSONValue>() {}
-        JSON( std::initializer_list<std::pair<const std::string, JSONValue>> args) : std::map<std::string, JSONValue>(args) {}
+    // Key of a JSON field. String literals, and other arrays of const char, are referenced rather than copied;
+    // keys given as `char*` or `const char*`, `std::string` or `std::string_view` are copied, since they may
+    // point into a buffer that doesn't outlive the JSON.
+    class JSONKey {
+    public:
+        template <size_t N>
+        JSONKey(const char (&key)[N]) : view(key) {}
+        template <size_t N>
+        JSONKey(char (&key)[N]) : owned(key) {}
+        template <typename CharPointer, typename std::enable_if<std::is_same<CharPointer, const char*>::value ||
+            std::is_same<CharPointer, char*>::value, bool>::type = true>
+        JSONKey(CharPointer key) : owned(key) {}
+        JSONKey(std::string key) : owned(std::move(key)) {}
+        JSONKey(std::string_view key) : owned(key) {}
+
+        std::string_view get() const { return owned.empty() ? view : std::string_view(owned); }
+        operator std::string_view() const { return get(); }
+        bool operator==(std::string_view other) const { return get() == other; }
+
+    private:
+        std::string_view view;
+        std::string owned;
+    };
+
+#ifdef __clang__
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+#endif
+    // A JSON object. Fields keep their insertion order and are stored inline up to INLINE_FIELDS, so building
+    // and walking a typical details object allocates nothing. As with `std::map`, a key given more than once in
+    // an initializer list keeps its first value, and the fields of the second list override those of the first.
+    // The `std::map` accessors that callers used (`find`, `operator[]`, `at`, `count` and `insert`) remain.
+    struct JSON {
+        typedef std::pair<JSONKey, JSONValue> Field;
+        // A Field is 88 bytes, so ten cost about 880 bytes inline: enough for the details of nearly every
+        // assertion without spilling, while a JSON still fits comfortably on the stack. Nested objects are
+        // boxed, so only the outermost object pays for this.
+        static constexpr size_t INLINE_FIELDS = 10;
+
+        JSON() {}
+        JSON( std::initializer_list<Field> args) {
+            reserve(args.size());
+            for (auto& field : args) {
+                insert(field);
+            }
+        }
+
+        JSON( std::initializer_list<Field> args, std::initializer_list<Field> more_args ) : JSON(args) {
+            for (auto& field : more_args) {
+                (*this)[field.first] = field.second;
+            }
+        }
 
-        JSON( std::initializer_list<std::pair<const std::string, JSONValue>> args, std::vector<std::pair<const std::string, JSONValue>> more_args ) : std::map<std::string, JSONValue>(args) {
+        JSON( std::initializer_list<Field> args, const std::vector<std::pair<const std::string, JSONValue>>& more_args ) : JSON(args) {
             for (auto& pair : more_args) {
                 (*this)[pair.first] = pair.second;
             }
         }
+
+        JSON(const JSON& other) {
+            reserve(other.field_count);
+            for (auto& field : other) {
+                push_back(field);
+            }
+        }
+
+        JSON(JSON&& other) noexcept {
+            take(other);
+        }
+
+        JSON& operator=(const JSON& other) {
+            if (this != &other) {
+                JSON copy(other);
+                *this = std::move(copy);
+            }
+            return *this;
+        }
+
+        JSON& operator=(JSON&& other) noexcept {
+            if (this != &other) {
+                destroy();
+                take(other);
+            }
+            return *this;
+        }
+
+        ~JSON() {
+            destroy();
+        }
+
+        size_t size() const { return field_count; }
+        bool empty() const { return field_count == 0; }
+
+        Field* begin() { return fields; }
+        Field* end() { return fields + field_count; }
+        const Field* begin() const { return fields; }
+        const Field* end() const { return fields + field_count; }
+
+        Field* find(std::string_view key) {
+            for (Field& field : *this) {
+                if (field.first == key) {
+                    return &field;
+                }
+            }
+            return end();
+        }
+
+        const Field* find(std::string_view key) const {
+            for (const Field& field : *this) {
+                if (field.first == key) {
+                    return &field;
+                }
+            }
+            return end();
+        }
+
+        JSONValue& operator[](JSONKey key) {
+            Field* field = find(key);
+            if (field == end()) {
+                field = &push_back(Field(std::move(key), JSONValue()));
+            }
+            return field->second;
+        }
+
+        JSONValue& at(std::string_view key) {
+            Field* field = find(key);
+            if (field == end()) {
+                throw std::out_of_range("antithesis::JSON::at: no such key");
+            }
+            return field->second;
+        }
+
+        const JSONValue& at(std::string_view key) const {
+            const Field* field = find(key);
+            if (field == end()) {
+                throw std::out_of_range("antithesis::JSON::at: no such key");
+            }
+            return field->second;
+        }
+
+        size_t count(std::string_view key) const {
+            return find(key) == end() ? 0 : 1;
+        }
+
+        // Adds a field unless its key is already present. Returns the field with that key, and whether it was added.
+        std::pair<Field*, bool> insert(const Field& field) {
+            Field* existing = find(field.first);
+            if (existing != end()) {
+                return { existing, false };
+            }
+            return { &push_back(field), true };
+        }
+
+        // Accepts the pairs that were inserted into the `std::map` JSON used to be, such as
+        // `std::pair<const std::string, JSONValue>`
+        template <typename Key, typename Value, typename std::enable_if<std::is_constructible<JSONKey, const Key&>::value &&
+            std::is_constructible<JSONValue, const Value&>::value, bool>::type = true>
+        std::pair<Field*, bool> insert(const std::pair<Key, Value>& pair) {
+            return insert(Field(JSONKey(pair.first), JSONValue(pair.second)));
+        }
+
+    private:
+        size_t field_count = 0;
+        size_t capacity = INLINE_FIELDS;
+        Field* fields = reinterpret_cast<Field*>(inline_fields);
+        alignas(Field) unsigned char inline_fields[INLINE_FIELDS * sizeof(Field)];
+
+        bool is_inline() const {
+            return fields == reinterpret_cast<const Field*>(inline_fields);
+        }
+
+        void reserve(size_t needed) {
+            if (needed <= capacity) {
+                return;
+            }
+            size_t new_capacity = needed > capacity * 2 ? needed : capacity * 2;
+            Field* new_fields = static_cast<Field*>(::operator new(new_capacity * sizeof(Field)));
+            for (size_t i = 0; i < field_count; i++) {
+                new (&new_fields[i]) Field(std::move(fields[i]));
+                fields[i].~Field();
+            }
+            if (!is_inline()) {
+                ::operator delete(fields);
+            }
+            fields = new_fields;
+            capacity = new_capacity;
+        }
+
+        template <typename F>
+        Field& push_back(F&& field) {
+            reserve(field_count + 1);
+            Field* added = new (&fields[field_count]) Field(std::forward<F>(field));
+            field_count++;
+            return *added;
+        }
+
+        // Leaves `other` empty
+        void take(JSON& other) {
+            if (other.is_inline()) {
+                for (Field& field : other) {
+                    push_back(std::move(field));
+                }
+                other.destroy();
+            } else {
+                fields = other.fields;
+                field_count = other.field_count;
+                capacity = other.capacity;
+                other.fields = reinterpret_cast<Field*>(other.inline_fields);
+                other.field_count = 0;
+                other.capacity = INLINE_FIELDS;
+            }
+        }
+
+        // Leaves this object empty, with its inline storage
+        void destroy() {
+            for (Field& field : *this) {
+                field.~Field();
+            }
+            if (!is_inline()) {
+                ::operator delete(fields);
+            }
+            fields = reinterpret_cast<Field*>(inline_fields);
+            field_count = 0;
+            capacity = INLINE_FIELDS;
+        }
+    };
+#ifdef __clang__
+    #pragma clang diagnostic pop
+#endif
+
+    inline JSONBox::JSONBox(const JSON& json) : object(new JSON(json)) {}
+    inline JSONBox::JSONBox(JSON&& json) : object(new JSON(std::move(json))) {}
+    inline JSONBox::JSONBox(const JSONBox& other) : object(other.object == nullptr ? nullptr : new JSON(*other.object)) {}
+    inline JSONBox::~JSONBox() { delete object; }
+
+    inline const JSON& JSONBox::get() const {
+        static const JSON empty;
+        return object == nullptr ? empty : *object;
+    }
+
+    // Where the SDK sends its records and gets its random values from. By default that is the Antithesis runtime
+    // when it is present, and ANTITHESIS_SDK_LOCAL_OUTPUT otherwise. Another handler can be registered at run
+    // time with `set_handler`, or bound at compile time with ANTITHESIS_SDK_HANDLER. Records are single JSON
+    // objects without a trailing newline, and every member may be called from any thread.
+    struct Handler {
+        virtual ~Handler() = default;
+        virtual void output(const char* message, size_t length) const = 0;
+        virtual uint64_t random() = 0;
+        // Fills `words` with random values, at the cost of one virtual call
+        virtual void random_fill(uint64_t* words, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                words[i] = random();
+            }
+        }
+        // Makes everything output so far visible to Antithesis; handlers that don't buffer have nothing to do
+        virtual void flush() const {}
+        // Adds handler-specific fields to the `antithesis_sdk` version record
+        virtual void add_to_version_record(JSON&) const {}
+        // Outputs a record that is part of a batch, which the caller completes with `flush`
+        virtual void output_unflushed(const char* message, size_t length) const {
+            output(message, length);
+        }
+        // Called when the process is about to die of a fatal signal or std::terminate, if ANTITHESIS_SDK_CRASH_FLUSH
+        // is set, to write out the records still buffered. It may run on any thread while another is emitting, so
+        // it must only make async-signal-safe calls and take no locks; `scratch` is preallocated space it may use.
+        virtual void emergency_flush(char* /*scratch*/, size_t /*scratch_size*/) const {}
     };
 }
 
@@ -73,24 +413,148 @@ namespace antithesis {
  * Used in both the NO_ANTITHESIS_SDK version and when running locally
  *****************************************************************************/
 
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
 #include <random>
 
+#ifndef NO_ANTITHESIS_SDK
+#include <pthread.h>
+#endif
+
 namespace antithesis::internal::random {
-    struct LocalRandom {
-        std::random_device device;
-        std::mt19937_64 gen;
-        std::uniform_int_distribution<unsigned long long> distribution;
+    constexpr const char* LOCAL_RANDOM_SEED_ENVIRONMENT_VARIABLE = "ANTITHESIS_SDK_LOCAL_RANDOM_SEED";
 
-        LocalRandom() : device(), gen(device()), distribution() {}
+    constexpr uint64_t SPLITMIX_GAMMA = 0x9E3779B97F4A7C15ull;
 
-        uint64_t random() {
-#ifdef ANTITHESIS_RANDOM_OVERRIDE
-            return ANTITHESIS_RANDOM_OVERRIDE();
+    inline uint64_t splitmix64(uint64_t& state) {
+        uint64_t z = (state += SPLITMIX_GAMMA);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // The full 128-bit product of two 64-bit values
+    struct Product128 {
+        uint64_t high;
+        uint64_t low;
+    };
+
+    inline Product128 multiply_128(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+        const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        return { static_cast<uint64_t>(product >> 64), static_cast<uint64_t>(product) };
 #else
-            return distribution(gen);
+        // Schoolbook multiplication on 32-bit halves, for compilers without a 128-bit integer type
+        const uint64_t a_low = a & 0xFFFFFFFFull, a_high = a >> 32;
+        const uint64_t b_low = b & 0xFFFFFFFFull, b_high = b >> 32;
+        const uint64_t low_low = a_low * b_low;
+        const uint64_t high_low = a_high * b_low;
+        const uint64_t low_high = a_low * b_high;
+        const uint64_t high_high = a_high * b_high;
+        const uint64_t middle = (low_low >> 32) + (high_low & 0xFFFFFFFFull) + low_high;
+        return { high_high + (high_low >> 32) + (middle >> 32), (middle << 32) | (low_low & 0xFFFFFFFFull) };
 #endif
+    }
+
+    // xoshiro256** (https://prng.di.unimi.it/), with 32 bytes of state
+    struct Xoshiro256StarStar {
+        std::array<uint64_t, 4> state;
+
+        static constexpr uint64_t rotl(uint64_t x, int k) {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        uint64_t next() {
+            const uint64_t result = rotl(state[1] * 5, 7) * 9;
+            const uint64_t t = state[1] << 17;
+            state[2] ^= state[0];
+            state[3] ^= state[1];
+            state[1] ^= state[2];
+            state[0] ^= state[3];
+            state[2] ^= t;
+            state[3] = rotl(state[3], 45);
+            return result;
         }
     };
+
+    // The seed that every local random stream derives from: `ANTITHESIS_SDK_LOCAL_RANDOM_SEED` (decimal, or hex
+    // with 0x) if it is set, and otherwise a fresh value from std::random_device. It is fixed for the process.
+    inline uint64_t get_local_random_seed() {
+        static const uint64_t seed = [] {
+            const char* text = std::getenv(LOCAL_RANDOM_SEED_ENVIRONMENT_VARIABLE);
+            if (text != nullptr && text[0]) {
+                char* end = nullptr;
+                const unsigned long long parsed = std::strtoull(text, &end, 0);
+                if (*end == '\0') {
+                    return static_cast<uint64_t>(parsed);
+                }
+                fprintf(stderr, "[* antithesis-sdk-cpp *] Invalid value for %s: %s\n", LOCAL_RANDOM_SEED_ENVIRONMENT_VARIABLE, text);
+            }
+            std::random_device device;
+            return (static_cast<uint64_t>(device()) << 32) ^ static_cast<uint64_t>(device());
+        }();
+        return seed;
+    }
+
+    // The random streams of this process. A forked child would otherwise carry on with copies of its parent's
+    // generators, so it moves to a new `generation`, which makes every thread reseed, and a new `key`, derived
+    // from its parent's key and the number of forks the parent had made. A run that forks in the same order
+    // therefore sees the same values in every process.
+    struct ProcessStreams {
+        uint64_t key = 0;
+        std::atomic<uint64_t> forks{0};
+        std::atomic<uint64_t> next_stream{0};
+        std::atomic<uint64_t> generation{1};
+    };
+
+    inline ProcessStreams process_streams;
+
+    inline void count_fork() {
+        process_streams.forks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline void start_child_streams() {
+        uint64_t state = process_streams.key + process_streams.forks.load(std::memory_order_relaxed);
+        process_streams.key = splitmix64(state);
+        process_streams.forks.store(0, std::memory_order_relaxed);
+        process_streams.next_stream.store(0, std::memory_order_relaxed);
+        process_streams.generation.fetch_add(1, std::memory_order_relaxed);
+    }
+
+#ifndef NO_ANTITHESIS_SDK
+    // Only the full SDK registers fork handlers; the NO_ANTITHESIS_SDK polyfill stays free of POSIX threads
+    // and of static initialization, so its forked children share their parent's streams
+    [[maybe_unused]] inline const bool fork_handlers_registered = (pthread_atfork(count_fork, nullptr, start_child_streams), true);
+#endif
+
+    // Random values for running without Antithesis. Each thread draws from its own generator; the nth thread
+    // of a process to draw is seeded with outputs 4n to 4n+3 of splitmix64 over the process seed plus the
+    // process key, which is 0 for the process that was started. A run with the same seed, in which threads
+    // first draw in the same order, therefore sees exactly the same values.
+    inline uint64_t local_random() {
+#ifdef ANTITHESIS_RANDOM_OVERRIDE
+        return ANTITHESIS_RANDOM_OVERRIDE();
+#else
+        struct ThreadGenerator {
+            // The `generation` of the process that seeded the generator; 0 before it is seeded
+            uint64_t generation;
+            Xoshiro256StarStar generator;
+        };
+        thread_local ThreadGenerator thread_generator{};
+        const uint64_t generation = process_streams.generation.load(std::memory_order_relaxed);
+        if (__builtin_expect(thread_generator.generation != generation, false)) {
+            const uint64_t stream = process_streams.next_stream.fetch_add(1, std::memory_order_relaxed);
+            uint64_t splitmix_state = get_local_random_seed() + process_streams.key + stream * 4 * SPLITMIX_GAMMA;
+            for (uint64_t& word : thread_generator.generator.state) {
+                word = splitmix64(splitmix_state);
+            }
+            thread_generator.generation = generation;
+        }
+        return thread_generator.generator.next();
+#endif
+    }
 }
 
 /*****************************************************************************
@@ -100,182 +564,833 @@ namespace antithesis::internal::random {
 #ifndef NO_ANTITHESIS_SDK
 
 #include <array>
-#include <iomanip>
+#include <charconv>
+#include <string_view>
 
 namespace antithesis::internal::json {
     template<class>
     inline constexpr bool always_false_v = false;
 
-    static std::ostream& operator<<(std::ostream& out, const JSON& details);
+    inline constexpr bool needs_escape(const char c) {
+        return c == '"' || c == '\\' || ('\u0000' <= c && c <= '\u001F');
+    }
 
-    static void escaped(std::ostream& out, const char c) {
-        const char HEX[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+    template <typename Writer>
+    constexpr void write_escaped(Writer& writer, const char c) {
+        constexpr char HEX[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
         switch (c) {
-            case '\t': out << "\\t"; break;
-            case '\b': out << "\\b"; break;
-            case '\n': out << "\\n"; break;
-            case '\f': out << "\\f"; break;
-            case '\r': out << "\\r"; break;
-            case '\"': out << "\\\""; break;
-            case '\\': out << "\\\\"; break;
+            case '\t': writer.raw("\\t"); break;
+            case '\b': writer.raw("\\b"); break;
+            case '\n': writer.raw("\\n"); break;
+            case '\f': writer.raw("\\f"); break;
+            case '\r': writer.raw("\\r"); break;
+            case '\"': writer.raw("\\\""); break;
+            case '\\': writer.raw("\\\\"); break;
             default:
-                if ('\u0000' <= c && c <= '\u001F') {
-                    out << "\\u00" << HEX[(c >> 4) & 0x0F] << HEX[c & 0x0F];
+                writer.raw("\\u00");
+                writer.raw(HEX[(c >> 4) & 0x0F]);
+                writer.raw(HEX[c & 0x0F]);
+        }
+    }
+
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+    // Serializes JSON values as compact text, appending directly to a byte buffer.
+    // No iostreams or locales are involved, and nothing is allocated beyond growing `out`.
+    struct JSONWriter {
+        std::string& out;
+
+        explicit JSONWriter(std::string& out) : out(out) {}
+
+        void raw(char c) { out.push_back(c); }
+        void raw(std::string_view s) { out.append(s.data(), s.size()); }
+
+        void string(std::string_view s) {
+            out.push_back('"');
+            size_t run = 0;
+            for (size_t i = 0; i < s.size(); i++) {
+                const char c = s[i];
+                if (needs_escape(c)) {
+                    out.append(s.data() + run, i - run);
+                    write_escaped(*this, c);
+                    run = i + 1;
+                }
+            }
+            out.append(s.data() + run, s.size() - run);
+            out.push_back('"');
+        }
+
+        template <typename Number>
+        void number(Number n) {
+            std::array<char, 32> digits;
+            auto result = std::to_chars(digits.data(), digits.data() + digits.size(), n);
+            out.append(digits.data(), result.ptr);
+        }
+
+        void value(const JSONValue& json) {
+            std::visit([&](auto&& arg) {
+                using T = std::decay_t<decltype(arg)>;
+                if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+                    string(arg);
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    raw(arg ? "true" : "false");
+                } else if constexpr (std::is_same_v<T, char>) {
+                    string(std::string_view(&arg, 1));
+                } else if constexpr (std::is_same_v<T, int> || std::is_same_v<T, int16_t> || std::is_same_v<T, int64_t>) {
+                    number(arg);
+                } else if constexpr (std::is_same_v<T, uint32_t> || std::is_same_v<T, uint64_t>) {
+                    number(arg);
+                } else if constexpr (std::is_same_v<T, float>) {
+                    number(arg);
+                } else if constexpr (std::is_same_v<T, double>) {
+                    number(arg);
+                } else if constexpr (std::is_same_v<T, const char*>) {
+                    if (arg == nullptr) {
+                        raw("null");
+                    } else {
+                        string(arg);
+                    }
+                } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+                    raw("null");
+                } else if constexpr (std::is_same_v<T, JSONBox>) {
+                    object(arg.get());
+                } else if constexpr (std::is_same_v<T, JSONArray>) {
+                    raw('[');
+                    bool first = true;
+                    for (auto &item : arg) {
+                        if (!first) {
+                            raw(',');
+                        }
+                        first = false;
+                        value(item);
+                    }
+                    raw(']');
+#if defined(__cpp_lib_span)
+                } else if constexpr (std::is_same_v<T, JSONSpan>) {
+                    span(arg);
+#endif
                 } else {
-                    out << c;
+                    static_assert(always_false_v<T>, "non-exhaustive JSONValue visitor!");
                 }
+            }, json);
+        }
+
+#if defined(__cpp_lib_span)
+        void span(const JSONSpan& elements) {
+            switch (elements.element_type()) {
+                case JSONSpan::BOOL: array(elements.elements<bool>(), elements.size()); break;
+                case JSONSpan::CHAR: array(elements.elements<char>(), elements.size()); break;
+                case JSONSpan::SIGNED_CHAR: array(elements.elements<signed char>(), elements.size()); break;
+                case JSONSpan::UNSIGNED_CHAR: array(elements.elements<unsigned char>(), elements.size()); break;
+                case JSONSpan::SHORT: array(elements.elements<short>(), elements.size()); break;
+                case JSONSpan::UNSIGNED_SHORT: array(elements.elements<unsigned short>(), elements.size()); break;
+                case JSONSpan::INT: array(elements.elements<int>(), elements.size()); break;
+                case JSONSpan::UNSIGNED_INT: array(elements.elements<unsigned int>(), elements.size()); break;
+                case JSONSpan::LONG: array(elements.elements<long>(), elements.size()); break;
+                case JSONSpan::UNSIGNED_LONG: array(elements.elements<unsigned long>(), elements.size()); break;
+                case JSONSpan::LONG_LONG: array(elements.elements<long long>(), elements.size()); break;
+                case JSONSpan::UNSIGNED_LONG_LONG: array(elements.elements<unsigned long long>(), elements.size()); break;
+                case JSONSpan::FLOAT: array(elements.elements<float>(), elements.size()); break;
+                case JSONSpan::DOUBLE: array(elements.elements<double>(), elements.size()); break;
+            }
         }
-    }
 
-    static std::ostream& operator<<(std::ostream& out, const JSONValue& json) {
-        std::visit([&](auto&& arg) {
-            using T = std::decay_t<decltype(arg)>;
-            if constexpr (std::is_same_v<T, std::string>) {
-                out << '"';
-                for (auto c : arg) {
-                    escaped(out, c);
+        template <typename T>
+        void array(const T* elements, size_t size) {
+            raw('[');
+            for (size_t i = 0; i < size; i++) {
+                if (i > 0) {
+                    raw(',');
                 }
-                out << '"';
-            } else if constexpr (std::is_same_v<T, bool>) {
-                out << (arg ? "true" : "false");
-            } else if constexpr (std::is_same_v<T, char>) {
-                out << '"';
-                escaped(out, arg);
-                out << '"';
-            } else if constexpr (std::is_same_v<T, int>) {
-                out << arg;
-            } else if constexpr (std::is_same_v<T, uint64_t>) {
-                out << arg;
-            } else if constexpr (std::is_same_v<T, float>) {
-                out << arg;
-            } else if constexpr (std::is_same_v<T, double>) {
-                out << arg;
-            } else if constexpr (std::is_same_v<T, const char*>) {
-                out << '"';
-                for (auto str = arg; *str != '\0'; str++) {
-                    escaped(out, *str);
+                if constexpr (std::is_same_v<T, bool>) {
+                    raw(elements[i] ? "true" : "false");
+                } else if constexpr (std::is_same_v<T, char>) {
+                    string(std::string_view(&elements[i], 1));
+                } else {
+                    number(elements[i]);
                 }
-                out << '"';
-            } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
-                out << "null";
-            } else if constexpr (std::is_same_v<T, JSON>) {
-                out << arg;
-            } else if constexpr (std::is_same_v<T, JSONArray>) {
-                out << '[';
-                bool first = true;
-                for (auto &item : arg) {
-                    if (!first) {
-                        out << ',';
-                    }
-                    first = false;
-                    out << item;
+            }
+            raw(']');
+        }
+#endif
+
+        void object(const JSON& details) {
+            raw('{');
+            bool first = true;
+            for (auto& [key, value] : details) {
+                if (!first) {
+                    raw(',');
                 }
-                out << ']';
-            } else {
-                static_assert(always_false_v<T>, "non-exhaustive JSONValue visitor!");
+                string(key);
+                raw(':');
+                this->value(value);
+                first = false;
             }
-        }, json);
+            raw('}');
+        }
+    };
 
-        return out;
-    }
+    // Renders JSON text during constant evaluation, for records whose content is known at compile time.
+    // Without a destination it only measures, so that callers can size a std::array before rendering into it.
+    struct ConstexprWriter {
+        char* out = nullptr;
+        size_t size = 0;
 
-    static std::ostream& operator<<(std::ostream& out, const JSON& details) {
-        out << '{';
+        constexpr void raw(char c) {
+            if (out != nullptr) {
+                out[size] = c;
+            }
+            size++;
+        }
+
+        constexpr void raw(std::string_view s) {
+            for (char c : s) {
+                raw(c);
+            }
+        }
+
+        constexpr void string(std::string_view s) {
+            raw('"');
+            for (char c : s) {
+                if (needs_escape(c)) {
+                    write_escaped(*this, c);
+                } else {
+                    raw(c);
+                }
+            }
+            raw('"');
+        }
 
-        bool first = true;
-        for (auto [key, value] : details) {
-            if (!first) {
-                out << ',';
+        constexpr void number(long long n) {
+            unsigned long long magnitude = n < 0 ? 0ull - static_cast<unsigned long long>(n) : static_cast<unsigned long long>(n);
+            std::array<char, 20> digits{};
+            size_t count = 0;
+            do {
+                digits[count++] = static_cast<char>('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude != 0);
+            if (n < 0) {
+                raw('-');
             }
-            out << '"';
-            for (auto c : key) {
-                escaped(out, c);
+            while (count > 0) {
+                raw(digits[--count]);
             }
-            out << '"' << ':' << value;
-            first = false;
         }
+    };
+
+    // Renders `Record::render` into an array sized to fit exactly, at compile time.
+    template <typename Record>
+    constexpr auto prerender() {
+        constexpr size_t size = [] {
+            ConstexprWriter measure;
+            Record::render(measure);
+            return measure.size;
+        }();
+        std::array<char, size> rendered{};
+        ConstexprWriter writer{ rendered.data(), 0 };
+        Record::render(writer);
+        return rendered;
+    }
+    #pragma clang diagnostic pop
 
-        out << '}';
-        return out;
+    // Called by each thread when it first renders a record; set by the crash handler
+    inline void (*on_thread_buffer_created)() = nullptr;
+
+    // Per-thread scratch buffer that records are rendered into before being handed to a handler.
+    // It keeps its capacity between records, so steady-state emission does not allocate.
+    inline std::string& get_thread_buffer() {
+        static constexpr size_t MAX_RETAINED_CAPACITY = 64 * 1024;
+        // The main thread's thread-locals are destroyed before exit handlers and static destructors run, and
+        // those may still emit; they then get a buffer of their own, which is leaked
+        struct ThreadBuffer {
+            std::string* buffer = nullptr;
+            ~ThreadBuffer() {
+                delete buffer;
+                buffer = nullptr;
+            }
+        };
+        thread_local ThreadBuffer thread_buffer;
+        if (__builtin_expect(thread_buffer.buffer == nullptr, false)) {
+            thread_buffer.buffer = new std::string();
+            if (on_thread_buffer_created != nullptr) {
+                on_thread_buffer_created();
+            }
+        }
+        std::string& buffer = *thread_buffer.buffer;
+        if (buffer.capacity() > MAX_RETAINED_CAPACITY) {
+            std::string().swap(buffer);
+        }
+        buffer.clear();
+        return buffer;
     }
 }
 
 #endif
 
 /*****************************************************************************
- * INTERNAL HELPERS: HANDLERS
- * Implementations for running locally and running in Antithesis
+ * INTERNAL HELPERS: CBOR
+ * Compact binary encoding of records for local output
  *****************************************************************************/
 
 #ifndef NO_ANTITHESIS_SDK
 
-#include <cstdio>
-#include <iostream>
-#include <sstream>
-#include <dlfcn.h>
-#include <memory>
-#include <cstring>
-#include <cstdlib>
-#include <fcntl.h>
-#include <unistd.h>
-#include <sys/stat.h>
+#include <bit>
+#include <unordered_map>
 
+namespace antithesis::internal::cbor {
+    using namespace antithesis::internal::json;
 
-namespace antithesis::internal::handlers {
-    constexpr const char* const ERROR_LOG_LINE_PREFIX = "[* antithesis-sdk-cpp *]";
-    constexpr const char* LIB_PATH = "/usr/lib/libvoidstar.so";
-    constexpr const char* LOCAL_OUTPUT_ENVIRONMENT_VARIABLE = "ANTITHESIS_SDK_LOCAL_OUTPUT";
+    enum MajorType : uint8_t {
+        UNSIGNED_INTEGER = 0,
+        NEGATIVE_INTEGER = 1,
+        TEXT_STRING = 3,
+        ARRAY = 4,
+        MAP = 5,
+        TAG = 6,
+        SIMPLE = 7,
+    };
 
-    using namespace antithesis::internal::json;
-    
-    struct LibHandler {
-        virtual ~LibHandler() = default;
-        virtual void output(const char* message) const = 0;
-        virtual uint64_t random() = 0;
+    constexpr uint64_t SELF_DESCRIBED_TAG = 55799;
+    constexpr uint64_t STRINGREF_NAMESPACE_TAG = 256;
+    constexpr uint64_t STRINGREF_TAG = 25;
+    constexpr uint8_t FALSE_VALUE = 0xF4;
+    constexpr uint8_t TRUE_VALUE = 0xF5;
+    constexpr uint8_t NULL_VALUE = 0xF6;
+    constexpr uint8_t FLOAT32_VALUE = 0xFA;
+    constexpr uint8_t FLOAT64_VALUE = 0xFB;
+    constexpr uint8_t INDEFINITE_ARRAY = 0x9F;
+    constexpr uint8_t INDEFINITE_MAP = 0xBF;
+    constexpr uint8_t BREAK = 0xFF;
+
+    // Shortest string that a stringref namespace with `count` entries adds to its table
+    constexpr size_t stringref_min_length(size_t count) {
+        return count < 24 ? 3 : count < 256 ? 4 : count < 65536 ? 5 : count < 4294967296ull ? 7 : 11;
+    }
+
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+    inline void write_head(std::string& out, MajorType major, uint64_t value) {
+        const char type = static_cast<char>(major << 5);
+        if (value < 24) {
+            out.push_back(static_cast<char>(type | static_cast<char>(value)));
+            return;
+        }
+        int bytes = value <= 0xFF ? 1 : value <= 0xFFFF ? 2 : value <= 0xFFFFFFFF ? 4 : 8;
+        out.push_back(static_cast<char>(type | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27)));
+        for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<char>(value >> shift));
+        }
+    }
+
+    // `true` or `false`, encoded
+    inline std::string_view encoded_bool(bool value) {
+        static constexpr char BOOLS[2] = { static_cast<char>(FALSE_VALUE), static_cast<char>(TRUE_VALUE) };
+        return std::string_view(BOOLS + (value ? 1 : 0), 1);
+    }
+
+    // Serializes JSON values as CBOR (RFC 8949), with the interface of JSONWriter; `raw` appends bytes that
+    // are already encoded. Strings are written in full, so the output doesn't depend on any stringref table.
+    // Integers stay integers, and floats and doubles are written as float32 and float64, which a decoder
+    // formats with `std::to_chars` for the type to reproduce what JSONWriter writes.
+    struct CBORWriter {
+        std::string& out;
+
+        explicit CBORWriter(std::string& out) : out(out) {}
 
-        void output(const JSON& json) const {
-            std::ostringstream out;
-            out << json;
-            output(out.str().c_str());
+        void raw(char c) { out.push_back(c); }
+        void raw(std::string_view s) { out.append(s.data(), s.size()); }
+
+        void string(std::string_view s) {
+            write_head(out, TEXT_STRING, s.size());
+            out.append(s.data(), s.size());
         }
-    };
 
-    struct AntithesisHandler : LibHandler {
-        void output(const char* message) const override {
-            if (message != nullptr) {
-                fuzz_json_data(message, strlen(message));
-                fuzz_flush();
+        template <typename Number>
+        void number(Number n) {
+            if constexpr (std::is_floating_point_v<Number>) {
+                if constexpr (std::is_same_v<Number, float>) {
+                    floating(FLOAT32_VALUE, std::bit_cast<uint32_t>(n), 4);
+                } else {
+                    floating(FLOAT64_VALUE, std::bit_cast<uint64_t>(static_cast<double>(n)), 8);
+                }
+            } else if constexpr (std::is_signed_v<Number>) {
+                if (n < 0) {
+                    // -1 - n never overflows, unlike -n
+                    write_head(out, NEGATIVE_INTEGER, static_cast<uint64_t>(-1 - static_cast<int64_t>(n)));
+                } else {
+                    write_head(out, UNSIGNED_INTEGER, static_cast<uint64_t>(n));
+                }
+            } else {
+                write_head(out, UNSIGNED_INTEGER, static_cast<uint64_t>(n));
             }
         }
 
-        uint64_t random() override {
-            return fuzz_get_random();
+        void value(const JSONValue& json) {
+            std::visit([&](auto&& arg) {
+                using T = std::decay_t<decltype(arg)>;
+                if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+                    string(arg);
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    raw(encoded_bool(arg));
+                } else if constexpr (std::is_same_v<T, char>) {
+                    string(std::string_view(&arg, 1));
+                } else if constexpr (std::is_same_v<T, int> || std::is_same_v<T, int16_t> || std::is_same_v<T, int64_t>) {
+                    number(arg);
+                } else if constexpr (std::is_same_v<T, uint32_t> || std::is_same_v<T, uint64_t>) {
+                    number(arg);
+                } else if constexpr (std::is_same_v<T, float>) {
+                    number(arg);
+                } else if constexpr (std::is_same_v<T, double>) {
+                    number(arg);
+                } else if constexpr (std::is_same_v<T, const char*>) {
+                    if (arg == nullptr) {
+                        raw(static_cast<char>(NULL_VALUE));
+                    } else {
+                        string(arg);
+                    }
+                } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+                    raw(static_cast<char>(NULL_VALUE));
+                } else if constexpr (std::is_same_v<T, JSONBox>) {
+                    object(arg.get());
+                } else if constexpr (std::is_same_v<T, JSONArray>) {
+                    write_head(out, ARRAY, arg.size());
+                    for (auto &item : arg) {
+                        value(item);
+                    }
+#if defined(__cpp_lib_span)
+                } else if constexpr (std::is_same_v<T, JSONSpan>) {
+                    span(arg);
+#endif
+                } else {
+                    static_assert(always_false_v<T>, "non-exhaustive JSONValue visitor!");
+                }
+            }, json);
         }
 
-        static std::unique_ptr<AntithesisHandler> create() {
-            void* shared_lib = dlopen(LIB_PATH, RTLD_NOW);
-            if (!shared_lib) {
-                error("Can not load the Antithesis native library");
-                return nullptr;
+#if defined(__cpp_lib_span)
+        void span(const JSONSpan& elements) {
+            switch (elements.element_type()) {
+                case JSONSpan::BOOL: array(elements.elements<bool>(), elements.size()); break;
+                case JSONSpan::CHAR: array(elements.elements<char>(), elements.size()); break;
+                case JSONSpan::SIGNED_CHAR: array(elements.elements<signed char>(), elements.size()); break;
+                case JSONSpan::UNSIGNED_CHAR: array(elements.elements<unsigned char>(), elements.size()); break;
+                case JSONSpan::SHORT: array(elements.elements<short>(), elements.size()); break;
+                case JSONSpan::UNSIGNED_SHORT: array(elements.elements<unsigned short>(), elements.size()); break;
+                case JSONSpan::INT: array(elements.elements<int>(), elements.size()); break;
+                case JSONSpan::UNSIGNED_INT: array(elements.elements<unsigned int>(), elements.size()); break;
+                case JSONSpan::LONG: array(elements.elements<long>(), elements.size()); break;
+                case JSONSpan::UNSIGNED_LONG: array(elements.elements<unsigned long>(), elements.size()); break;
+                case JSONSpan::LONG_LONG: array(elements.elements<long long>(), elements.size()); break;
+                case JSONSpan::UNSIGNED_LONG_LONG: array(elements.elements<unsigned long long>(), elements.size()); break;
+                case JSONSpan::FLOAT: array(elements.elements<float>(), elements.size()); break;
+                case JSONSpan::DOUBLE: array(elements.elements<double>(), elements.size()); break;
             }
+        }
 
-            void* fuzz_json_data = dlsym(shared_lib, "fuzz_json_data");
-            if (!fuzz_json_data) {
-                error("Can not access symbol fuzz_json_data");
-                return nullptr;
+        template <typename T>
+        void array(const T* elements, size_t size) {
+            write_head(out, ARRAY, size);
+            for (size_t i = 0; i < size; i++) {
+                if constexpr (std::is_same_v<T, bool>) {
+                    raw(encoded_bool(elements[i]));
+                } else if constexpr (std::is_same_v<T, char>) {
+                    string(std::string_view(&elements[i], 1));
+                } else {
+                    number(elements[i]);
+                }
             }
+        }
+#endif
 
-            void* fuzz_flush = dlsym(shared_lib, "fuzz_flush");
-            if (!fuzz_flush) {
-                error("Can not access symbol fuzz_flush");
-                return nullptr;
+        void object(const JSON& details) {
+            write_head(out, MAP, details.size());
+            for (auto& [key, value] : details) {
+                string(key);
+                this->value(value);
             }
+        }
 
-            void* fuzz_get_random = dlsym(shared_lib, "fuzz_get_random");
-            if (!fuzz_get_random) {
-                error("Can not access symbol fuzz_get_random");
-                return nullptr;
-            }
+        // Opens a stringref namespace of its own for the next data item, so that its strings, which
+        // CBOREncoder doesn't see, stay out of the table of the namespace around it.
+        void isolate() {
+            write_head(out, TAG, STRINGREF_NAMESPACE_TAG);
+        }
+
+        // An object that may hold strings, isolated unless it is empty
+        void isolated_object(const JSON& details) {
+            if (details.size() > 0) {
+                isolate();
+            }
+            object(details);
+        }
+
+    private:
+        void floating(uint8_t initial, uint64_t bits, int bytes) {
+            out.push_back(static_cast<char>(initial));
+            for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+                out.push_back(static_cast<char>(bits >> shift));
+            }
+        }
+    };
+
+    // Keys that complete the record of an assertion or guidepost after its prerendered prefix
+    enum Key : uint8_t { HIT_KEY, CONDITION_KEY, DETAILS_KEY, GUIDANCE_DATA_KEY, KEY_COUNT };
+    inline constexpr std::array<std::string_view, KEY_COUNT> KEY_NAMES = { "hit", "condition", "details", "guidance_data" };
+
+    // A member that completes a site's record: its key and its value, already encoded by CBORWriter
+    struct Member {
+        Key key;
+        std::string_view value;
+    };
+    constexpr size_t MAX_MEMBERS = 3;
+
+    // Writes records as CBOR into a sequence of stringref namespaces (tag 256, see
+    // http://cbor.schmorp.de/stringref), each an indefinite array of records, so that a key, message or
+    // location string seen before in the namespace is written as a short reference into its table. The output
+    // starts with the self-described CBOR tag, which also serves as a magic number. A namespace is closed, and
+    // a new one opened, once its table is full; this bounds the memory used.
+    //
+    // The record of an assertion or guidepost is its prerendered JSON prefix, encoded the first time the site
+    // is seen in a namespace and copied after that, followed by the members that complete it. Everything else
+    // in a record is encoded by CBORWriter in a namespace of its own, so the table only changes when a site is
+    // first seen. Once it has been seen, its record can be gathered by any number of threads at once.
+    class CBOREncoder {
+    public:
+        // Appends the record of the site whose prerendered prefix is `prefix`, adding its strings to the table
+        // if this is the first time it is seen.
+        void site_record(std::string& out, std::string_view prefix, const Member* members, size_t count) {
+            open_namespace(out);
+            auto found = sites.find(prefix.data());
+            if (found == sites.end() || found->second.prefix_size != prefix.size()) {
+                Site site{ prefix.size(), 0, std::string() };
+                encode_prefix(prefix, out, site);
+                found = sites.insert_or_assign(prefix.data(), std::move(site)).first;
+            } else {
+                out.append(found->second.encoded);
+            }
+            for (size_t i = 0; i < count; i++) {
+                std::string& key = keys[members[i].key];
+                if (key.empty()) {
+                    text_string(KEY_NAMES[members[i].key], out, key);
+                } else {
+                    out.append(key);
+                }
+                out.append(members[i].value);
+            }
+            out.append(found->second.open_maps, static_cast<char>(BREAK));
+        }
+
+        // Gathers the record of a site that has been seen in the open namespace into `parts`, without changing
+        // anything, and returns the number of parts; 0 if the site or one of the keys is yet to be seen.
+        size_t gather(std::string_view prefix, const Member* members, size_t count, std::string_view* parts) const {
+            static constexpr char BREAKS[] = { static_cast<char>(BREAK), static_cast<char>(BREAK), static_cast<char>(BREAK), static_cast<char>(BREAK) };
+            auto found = sites.find(prefix.data());
+            if (found == sites.end() || found->second.prefix_size != prefix.size() || found->second.open_maps > sizeof(BREAKS)) {
+                return 0;
+            }
+            size_t part_count = 0;
+            parts[part_count++] = found->second.encoded;
+            for (size_t i = 0; i < count; i++) {
+                if (keys[members[i].key].empty()) {
+                    return 0;
+                }
+                parts[part_count++] = keys[members[i].key];
+                parts[part_count++] = members[i].value;
+            }
+            parts[part_count++] = std::string_view(BREAKS, found->second.open_maps);
+            return part_count;
+        }
+
+        // Appends a record that makes no use of the table, such as one encoded by CBORWriter::isolated_object.
+        void record(std::string& out, std::string_view encoded) {
+            open_namespace(out);
+            out.append(encoded);
+        }
+
+        // Whether records can be appended without opening a namespace first
+        bool is_open() const {
+            return open;
+        }
+
+        // Closes the open namespace, if any, so that everything written so far is complete CBOR.
+        void finish(std::string& out) {
+            if (open) {
+                out.push_back(static_cast<char>(BREAK));
+                open = false;
+                strings.clear();
+                sites.clear();
+                keys = {};
+            }
+        }
+
+    private:
+        static constexpr size_t MAX_STRINGS = 65536;
+
+        struct Site {
+            size_t prefix_size;
+            // Maps the prefix leaves open, for the record to close
+            size_t open_maps;
+            // The prefix as written once its strings are in the table
+            std::string encoded;
+        };
+
+        bool started = false;
+        bool open = false;
+        std::unordered_map<std::string, uint64_t> strings;
+        // By the address of the prerendered prefix, which is static
+        std::unordered_map<const char*, Site> sites;
+        // Encoded keys, as written once they are in the table; empty until first written
+        std::array<std::string, KEY_COUNT> keys;
+        // The string being read from a prefix, unescaped
+        std::string text;
+
+        void open_namespace(std::string& out) {
+            if (strings.size() >= MAX_STRINGS) {
+                finish(out);
+            }
+            if (open) {
+                return;
+            }
+            if (!started) {
+                write_head(out, TAG, SELF_DESCRIBED_TAG);
+                started = true;
+            }
+            write_head(out, TAG, STRINGREF_NAMESPACE_TAG);
+            out.push_back(static_cast<char>(INDEFINITE_ARRAY));
+            open = true;
+        }
+
+        // Writes `s` to `out` as a reference if it is already in the table, and otherwise in full, adding it to
+        // the table by the same rule a decoder applies. `cached` gets the form later records use.
+        void text_string(std::string_view s, std::string& out, std::string& cached) {
+            const size_t out_start = out.size();
+            auto found = strings.find(std::string(s));
+            if (found == strings.end() && s.size() >= stringref_min_length(strings.size())) {
+                write_head(out, TEXT_STRING, s.size());
+                out.append(s.data(), s.size());
+                found = strings.emplace(s, strings.size()).first;
+                write_head(cached, TAG, STRINGREF_TAG);
+                write_head(cached, UNSIGNED_INTEGER, found->second);
+                return;
+            }
+            if (found != strings.end()) {
+                write_head(out, TAG, STRINGREF_TAG);
+                write_head(out, UNSIGNED_INTEGER, found->second);
+            } else {
+                write_head(out, TEXT_STRING, s.size());
+                out.append(s.data(), s.size());
+            }
+            cached.append(out, out_start, std::string::npos);
+        }
+
+        // Encodes a prefix rendered by render_assertion_prefix or render_guidance_prefix. Its objects become
+        // indefinite-length maps, the last ones left open. It was written by JSONWriter or ConstexprWriter,
+        // so only their escapes need reading.
+        void encode_prefix(std::string_view prefix, std::string& out, Site& site) {
+            size_t depth = 0;
+            for (size_t i = 0; i < prefix.size();) {
+                switch (prefix[i]) {
+                    case '{':
+                        out.push_back(static_cast<char>(INDEFINITE_MAP));
+                        site.encoded.push_back(static_cast<char>(INDEFINITE_MAP));
+                        depth++;
+                        i++;
+                        break;
+                    case '}':
+                        out.push_back(static_cast<char>(BREAK));
+                        site.encoded.push_back(static_cast<char>(BREAK));
+                        depth--;
+                        i++;
+                        break;
+                    case ',':
+                    case ':':
+                        i++;
+                        break;
+                    case '"':
+                        i = unescape(prefix, i + 1);
+                        text_string(text, out, site.encoded);
+                        break;
+                    case 't':
+                    case 'f':
+                    case 'n': {
+                        const uint8_t encoded = prefix[i] == 't' ? TRUE_VALUE : prefix[i] == 'f' ? FALSE_VALUE : NULL_VALUE;
+                        out.push_back(static_cast<char>(encoded));
+                        site.encoded.push_back(static_cast<char>(encoded));
+                        i += prefix[i] == 'f' ? 5 : 4;
+                        break;
+                    }
+                    default: {
+                        int64_t n = 0;
+                        auto result = std::from_chars(prefix.data() + i, prefix.data() + prefix.size(), n);
+                        const size_t start = site.encoded.size();
+                        CBORWriter(site.encoded).number(n);
+                        out.append(site.encoded, start, std::string::npos);
+                        i = static_cast<size_t>(result.ptr - prefix.data());
+                    }
+                }
+            }
+            site.open_maps = depth;
+        }
+
+        // Reads the string starting at `prefix[i]` into `text`, returning the position after its closing quote.
+        size_t unescape(std::string_view prefix, size_t i) {
+            text.clear();
+            while (i < prefix.size() && prefix[i] != '"') {
+                if (prefix[i] != '\\') {
+                    text.push_back(prefix[i++]);
+                    continue;
+                }
+                switch (prefix[i + 1]) {
+                    case 't': text.push_back('\t'); break;
+                    case 'b': text.push_back('\b'); break;
+                    case 'n': text.push_back('\n'); break;
+                    case 'f': text.push_back('\f'); break;
+                    case 'r': text.push_back('\r'); break;
+                    case 'u': {
+                        // \u00XX, for the other control characters
+                        uint32_t c = 0;
+                        std::from_chars(prefix.data() + i + 4, prefix.data() + i + 6, c, 16);
+                        text.push_back(static_cast<char>(c));
+                        i += 4;
+                        break;
+                    }
+                    default: text.push_back(prefix[i + 1]);
+                }
+                i += 2;
+            }
+            return i + 1;
+        }
+    };
+    #pragma clang diagnostic pop
+}
+
+#endif
+
+/*****************************************************************************
+ * INTERNAL HELPERS: HANDLERS
+ * Implementations for running locally and running in Antithesis
+ *****************************************************************************/
+
+#ifndef NO_ANTITHESIS_SDK
+
+#include <cstdio>
+#include <dlfcn.h>
+#include <memory>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <pthread.h>
+#include <csignal>
+#include <exception>
+
+
+// The Antithesis runtime library. Define this, or set `ANTITHESIS_SDK_LIB_PATH` at run time, to load a different
+// library, such as the fake libvoidstar in tools/.
+#ifndef ANTITHESIS_SDK_DEFAULT_LIB_PATH
+    #define ANTITHESIS_SDK_DEFAULT_LIB_PATH "/usr/lib/libvoidstar.so"
+#endif
+
+namespace antithesis::internal::handlers {
+    constexpr const char* const ERROR_LOG_LINE_PREFIX = "[* antithesis-sdk-cpp *]";
+    constexpr const char* LIB_PATH = ANTITHESIS_SDK_DEFAULT_LIB_PATH;
+    constexpr const char* LIB_PATH_ENVIRONMENT_VARIABLE = "ANTITHESIS_SDK_LIB_PATH";
+    constexpr const char* LOCAL_OUTPUT_ENVIRONMENT_VARIABLE = "ANTITHESIS_SDK_LOCAL_OUTPUT";
+    constexpr const char* LOCAL_OUTPUT_ASYNC_ENVIRONMENT_VARIABLE = "ANTITHESIS_SDK_LOCAL_OUTPUT_ASYNC";
+    constexpr const char* LOCAL_OUTPUT_FORMAT_ENVIRONMENT_VARIABLE = "ANTITHESIS_SDK_LOCAL_OUTPUT_FORMAT";
+    constexpr const char* LOCAL_OUTPUT_SHM_ENVIRONMENT_VARIABLE = "ANTITHESIS_SDK_LOCAL_OUTPUT_SHM";
+    constexpr const char* LOCAL_OUTPUT_SHM_SIZE_ENVIRONMENT_VARIABLE = "ANTITHESIS_SDK_LOCAL_OUTPUT_SHM_SIZE";
+    constexpr const char* LOCAL_OUTPUT_SHM_FULL_ENVIRONMENT_VARIABLE = "ANTITHESIS_SDK_LOCAL_OUTPUT_SHM_FULL";
+    constexpr const char* FLUSH_THRESHOLD_ENVIRONMENT_VARIABLE = "ANTITHESIS_SDK_FLUSH_THRESHOLD";
+    constexpr const char* CRASH_FLUSH_ENVIRONMENT_VARIABLE = "ANTITHESIS_SDK_CRASH_FLUSH";
+
+    using namespace antithesis::internal::json;
+
+    // The runtime library to load: `ANTITHESIS_SDK_LIB_PATH` if it is set to a non-empty path, and LIB_PATH otherwise
+    inline const char* get_lib_path() {
+        const char* path = std::getenv(LIB_PATH_ENVIRONMENT_VARIABLE);
+        return (path && path[0]) ? path : LIB_PATH;
+    }
+    
+    using LibHandler = antithesis::Handler;
+
+    struct AntithesisHandler final : LibHandler {
+        void output(const char* message, size_t length) const override {
+            if (message != nullptr) {
+                fuzz_json_data(message, length);
+                if (flush_threshold == 0) {
+                    fuzz_flush();
+                } else if (unflushed_bytes.fetch_add(length, std::memory_order_relaxed) + length >= flush_threshold) {
+                    flush();
+                }
+            }
+        }
+
+        void flush() const override {
+            if (unflushed_bytes.exchange(0, std::memory_order_relaxed) > 0) {
+                fuzz_flush();
+            }
+        }
+
+        void output_unflushed(const char* message, size_t length) const override {
+            if (message != nullptr) {
+                fuzz_json_data(message, length);
+                unflushed_bytes.fetch_add(length, std::memory_order_relaxed);
+            }
+        }
+
+        // Every record is already with the runtime, and only the flush deferred by the threshold is outstanding.
+        // `fuzz_flush` isn't known to be async-signal-safe, so there is no `emergency_flush`; on std::terminate,
+        // which isn't a signal, the crash handler calls `flush` instead.
+
+        uint64_t random() override {
+            return fuzz_get_random();
+        }
+
+        // The runtime hands out one word per call, and every call is a decision point for Antithesis,
+        // so nothing is fetched ahead of time
+        void random_fill(uint64_t* words, size_t count) override {
+            for (size_t i = 0; i < count; i++) {
+                words[i] = fuzz_get_random();
+            }
+        }
+
+        static std::unique_ptr<AntithesisHandler> create() {
+            void* shared_lib = dlopen(get_lib_path(), RTLD_NOW);
+            if (!shared_lib) {
+                error("Can not load the Antithesis native library");
+                return nullptr;
+            }
+
+            void* fuzz_json_data = dlsym(shared_lib, "fuzz_json_data");
+            if (!fuzz_json_data) {
+                error("Can not access symbol fuzz_json_data");
+                return nullptr;
+            }
+
+            void* fuzz_flush = dlsym(shared_lib, "fuzz_flush");
+            if (!fuzz_flush) {
+                error("Can not access symbol fuzz_flush");
+                return nullptr;
+            }
+
+            void* fuzz_get_random = dlsym(shared_lib, "fuzz_get_random");
+            if (!fuzz_get_random) {
+                error("Can not access symbol fuzz_get_random");
+                return nullptr;
+            }
 
             return std::unique_ptr<AntithesisHandler>(new AntithesisHandler(
                 reinterpret_cast<fuzz_json_data_t>(fuzz_json_data),
@@ -292,71 +1407,1129 @@ namespace antithesis::internal::handlers {
         fuzz_json_data_t fuzz_json_data;
         fuzz_flush_t fuzz_flush;
         fuzz_get_random_t fuzz_get_random;
+        // When non-zero, `fuzz_flush` is deferred until this many bytes are pending or `flush` is called
+        const size_t flush_threshold;
+        mutable std::atomic<size_t> unflushed_bytes;
 
         AntithesisHandler(fuzz_json_data_t fuzz_json_data, fuzz_flush_t fuzz_flush, fuzz_get_random_t fuzz_get_random) :
-            fuzz_json_data(fuzz_json_data), fuzz_flush(fuzz_flush), fuzz_get_random(fuzz_get_random) {}
+            fuzz_json_data(fuzz_json_data), fuzz_flush(fuzz_flush), fuzz_get_random(fuzz_get_random),
+            flush_threshold(get_flush_threshold()), unflushed_bytes(0) {}
+
+        // If `ANTITHESIS_SDK_FLUSH_THRESHOLD` is set to a positive number of bytes, records are coalesced
+        // and flushed once that many bytes are pending, as well as at setup_complete, send_event,
+        // antithesis::flush() and exit. Otherwise every record is flushed as soon as it is output.
+        static size_t get_flush_threshold() {
+            const char* threshold = std::getenv(FLUSH_THRESHOLD_ENVIRONMENT_VARIABLE);
+            if (!threshold || !threshold[0]) {
+                return 0;
+            }
+            return strtoull(threshold, nullptr, 10);
+        }
 
         static void error(const char* message) {
             fprintf(stderr, "%s %s: %s\n", ERROR_LOG_LINE_PREFIX, message, dlerror());
         }
     };
 
-    struct LocalHandler : LibHandler{
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+    // Writes `iov` out with as few writev calls as it takes; normally that is one, so that with O_APPEND the
+    // bytes land in the file together even when other processes append to it too.
+    inline void write_fully(int fd, iovec* iov, size_t iov_count) {
+        while (iov_count > 0) {
+            ssize_t written = writev(fd, iov, static_cast<int>(iov_count));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                fprintf(stderr, "%s Failed to write local output: %s\n", ERROR_LOG_LINE_PREFIX, strerror(errno));
+                return;
+            }
+            size_t remaining = static_cast<size_t>(written);
+            while (iov_count > 0 && remaining >= iov->iov_len) {
+                remaining -= iov->iov_len;
+                iov++;
+                iov_count--;
+            }
+            if (iov_count > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + remaining;
+                iov->iov_len -= remaining;
+            }
+        }
+    }
+
+    // The async-signal-safe counterpart of write_fully, for crash handlers; errors are ignored, as there is
+    // nothing left to report them to.
+    inline void emergency_write(int fd, const char* bytes, size_t length) {
+        while (length > 0) {
+            ssize_t written = ::write(fd, bytes, length);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return;
+            }
+            bytes += written;
+            length -= static_cast<size_t>(written);
+        }
+    }
+
+    // Moves local output off the threads that emit records. Each thread appends whole records to its own
+    // single-producer ring, and a background thread drains all rings into the output file with writev.
+    // When a ring is full, records are either waited for (`BLOCK`) or dropped and counted (`DROP`).
+    // With an encoder, rings hold the parts of CBOR records, which the background thread encodes as it drains.
+    struct AsyncWriter {
+        enum FullPolicy { BLOCK, DROP };
+
+        AsyncWriter(int fd, FullPolicy policy, antithesis::internal::cbor::CBOREncoder* encoder) :
+            fd(fd), policy(policy), encoder(encoder) {
+            thread = std::thread([this] { run(); });
+        }
+
+        void write(const char* message, size_t length) {
+            const std::array<std::string_view, 2> segments{ std::string_view(message, length), std::string_view("\n", 1) };
+            if (!append(segments.data(), segments.size())) {
+                write_through(message, length);
+            }
+        }
+
+        // The CBOR counterparts of `write`: the record of a site, as CBOREncoder::site_record takes it, and a
+        // record that makes no use of the stringref table
+        void write_site_record(std::string_view prefix, const antithesis::internal::cbor::Member* members, size_t count) {
+            Frame frame{};
+            frame.prefix = prefix.data();
+            frame.prefix_size = prefix.size();
+            frame.member_count = static_cast<uint32_t>(count);
+            std::array<std::string_view, 1 + antithesis::internal::cbor::MAX_MEMBERS> segments;
+            size_t size = sizeof(Frame);
+            for (size_t i = 0; i < count; i++) {
+                frame.keys[i] = members[i].key;
+                frame.value_sizes[i] = static_cast<uint32_t>(members[i].value.size());
+                segments[i + 1] = members[i].value;
+                size += members[i].value.size();
+            }
+            frame.size = size;
+            segments[0] = std::string_view(reinterpret_cast<const char*>(&frame), sizeof(Frame));
+            if (!append(segments.data(), count + 1)) {
+                encode_through([&](std::string& out) { encoder->site_record(out, prefix, members, count); });
+            }
+        }
+
+        void write_encoded(std::string_view encoded) {
+            Frame frame{};
+            frame.size = sizeof(Frame) + encoded.size();
+            frame.value_sizes[0] = static_cast<uint32_t>(encoded.size());
+            const std::array<std::string_view, 2> segments{ std::string_view(reinterpret_cast<const char*>(&frame), sizeof(Frame)), encoded };
+            if (!append(segments.data(), segments.size())) {
+                encode_through([&](std::string& out) { encoder->record(out, encoded); });
+            }
+        }
+
+        // Writes out everything appended so far and stops the background thread. Records written afterwards
+        // are written synchronously.
+        void stop() {
+            if (abandoned) {
+                return;
+            }
+            stopped.store(true, std::memory_order_seq_cst);
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            notify_space();
+            if (thread.joinable()) {
+                thread.join();
+            }
+            // Wait for threads that checked `stopped` just before it was set to finish appending, then write
+            // out their records too
+            for (Ring* ring = rings.load(std::memory_order_acquire); ring != nullptr; ring = ring->next) {
+                while (ring->appending.load(std::memory_order_seq_cst)) {
+                    std::this_thread::yield();
+                }
+            }
+            while (drain() > 0) {}
+            const uint64_t dropped_count = dropped.load(std::memory_order_relaxed);
+            if (dropped_count > 0) {
+                fprintf(stderr, "%s Dropped %llu records because local output could not keep up\n",
+                    ERROR_LOG_LINE_PREFIX, static_cast<unsigned long long>(dropped_count));
+            }
+        }
+
+        // Writes out what the rings hold, from a crash handler. No lock is taken, since the crashing thread may
+        // hold one: if the background thread is writing at the same moment, some records may be written twice,
+        // but none that was appended is lost. The pending bytes of a ring are gathered in `scratch` and written
+        // with as few write calls as it takes, so records stay whole when other processes append to the file.
+        // Records waiting to be encoded as CBOR can't be written by a crash handler and are lost.
+        void emergency_drain(char* scratch, size_t scratch_size) {
+            if (encoder != nullptr || scratch_size == 0) {
+                return;
+            }
+            for (Ring* ring = rings.load(std::memory_order_acquire); ring != nullptr; ring = ring->next) {
+                const size_t head = ring->head.load(std::memory_order_acquire);
+                size_t tail = ring->tail.load(std::memory_order_acquire);
+                while (tail != head) {
+                    const size_t length = std::min(head - tail, scratch_size);
+                    const size_t offset = tail % Ring::CAPACITY;
+                    const size_t first = std::min(length, Ring::CAPACITY - offset);
+                    memcpy(scratch, ring->data.data() + offset, first);
+                    memcpy(scratch + first, ring->data.data(), length - first);
+                    emergency_write(fd, scratch, length);
+                    tail += length;
+                }
+                ring->tail.store(head, std::memory_order_release);
+            }
+        }
+
+        // Called in a forked child, where the background thread doesn't exist. The records in the rings were
+        // appended by the parent, which writes them out itself, so the child leaves them alone.
+        void abandon() {
+            abandoned = true;
+        }
+
+    private:
+        struct Ring {
+            static constexpr size_t CAPACITY = 128 * 1024;
+
+            // Total bytes ever appended by the owning thread, and ever drained by the writer
+            alignas(64) std::atomic<size_t> head{0};
+            // Set while the owning thread appends a record
+            std::atomic<bool> appending{false};
+            alignas(64) std::atomic<size_t> tail{0};
+            // Set when the owning thread exits; once drained, the ring goes to the next thread that starts emitting
+            std::atomic<bool> orphaned{false};
+            Ring* next = nullptr;
+            std::array<char, CAPACITY> data;
+
+            void copy_in(size_t position, const char* bytes, size_t length) {
+                const size_t offset = position % CAPACITY;
+                const size_t first = std::min(length, CAPACITY - offset);
+                memcpy(data.data() + offset, bytes, first);
+                memcpy(data.data(), bytes + first, length - first);
+            }
+        };
+
+        struct ThreadRing {
+            Ring* ring = nullptr;
+
+            // The main thread's thread-locals are destroyed before exit handlers run, and those may still emit;
+            // they then get a fresh ring, which is drained like any other
+            ~ThreadRing() {
+                if (ring != nullptr) {
+                    ring->orphaned.store(true, std::memory_order_release);
+                    ring = nullptr;
+                }
+            }
+        };
+
+        struct Pending {
+            Ring* ring;
+            size_t head;
+        };
+
+        // How a CBOR record is held in a ring until it is encoded: this header, then the values of its members
+        // back to back. A record without a prefix has a single value, already encoded.
+        struct Frame {
+            // Bytes of the frame, this header included
+            size_t size;
+            const char* prefix;
+            size_t prefix_size;
+            uint32_t member_count;
+            std::array<uint32_t, antithesis::internal::cbor::MAX_MEMBERS> value_sizes;
+            std::array<antithesis::internal::cbor::Key, antithesis::internal::cbor::MAX_MEMBERS> keys;
+        };
+
+        static constexpr auto POLL_INTERVAL = std::chrono::milliseconds(5);
+        static constexpr size_t BATCH_RINGS = IOV_MAX / 2;
+
+        int fd;
+        FullPolicy policy;
+        antithesis::internal::cbor::CBOREncoder* encoder;
+        // Records of the current batch as encoded by `encoder`, and a place to join records that wrap
+        std::string encoded;
+        std::string wrapped;
+        std::atomic<uint64_t> dropped{0};
+        std::mutex rings_mutex;
+        // Only ever prepended to, so that `emergency_drain` can walk it without the lock
+        std::atomic<Ring*> rings{nullptr};
+        std::mutex wake_mutex;
+        std::condition_variable wake;
+        // For threads waiting for space with the BLOCK policy
+        std::mutex space_mutex;
+        std::condition_variable space;
+        bool wake_requested = false;
+        bool stopping = false;
+        std::atomic<bool> stopped{false};
+        bool abandoned = false;
+        std::thread thread;
+
+        // Appends the concatenation of `segments` to the calling thread's ring as one record. Returns false if the
+        // record is for the caller to write synchronously.
+        bool append(const std::string_view* segments, size_t count) {
+            size_t needed = 0;
+            for (size_t i = 0; i < count; i++) {
+                needed += segments[i].size();
+            }
+            // Too large to ever fit in a ring
+            if (needed > Ring::CAPACITY) {
+                return false;
+            }
+
+            Ring& ring = get_thread_ring();
+            // Set before `stopped` is checked, and `stopped` is set before stop() looks at it, so either this
+            // thread sees `stopped` or stop() waits for the record to be published
+            ring.appending.store(true, std::memory_order_seq_cst);
+            // Emitted after the background thread has stopped, as by later exit handlers and static destructors
+            if (stopped.load(std::memory_order_seq_cst)) {
+                ring.appending.store(false, std::memory_order_release);
+                return false;
+            }
+
+            const size_t head = ring.head.load(std::memory_order_relaxed);
+            size_t tail = ring.tail.load(std::memory_order_acquire);
+            if (Ring::CAPACITY - (head - tail) < needed) {
+                if (policy == DROP) {
+                    ring.appending.store(false, std::memory_order_release);
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                request_drain();
+                std::unique_lock<std::mutex> lock(space_mutex);
+                space.wait(lock, [&] {
+                    tail = ring.tail.load(std::memory_order_acquire);
+                    return Ring::CAPACITY - (head - tail) >= needed || stopped.load(std::memory_order_acquire);
+                });
+                if (Ring::CAPACITY - (head - tail) < needed) {
+                    // Nothing will drain the ring any more
+                    ring.appending.store(false, std::memory_order_release);
+                    return false;
+                }
+            }
+
+            size_t position = head;
+            for (size_t i = 0; i < count; i++) {
+                ring.copy_in(position, segments[i].data(), segments[i].size());
+                position += segments[i].size();
+            }
+            ring.head.store(head + needed, std::memory_order_release);
+            ring.appending.store(false, std::memory_order_release);
+
+            // Wake the writer early once a ring reaches half full, rather than waiting for its next poll
+            if (head - tail < Ring::CAPACITY / 2 && head + needed - tail >= Ring::CAPACITY / 2) {
+                request_drain();
+            }
+            return true;
+        }
+
+        // Wakes threads waiting in `append` for their ring to have space
+        void notify_space() {
+            // Taking the lock orders this after any waiter's check of the ring, so the wakeup isn't missed
+            { std::lock_guard<std::mutex> lock(space_mutex); }
+            space.notify_all();
+        }
+
+        Ring& get_thread_ring() {
+            thread_local ThreadRing thread_ring;
+            if (__builtin_expect(thread_ring.ring == nullptr, false)) {
+                std::lock_guard<std::mutex> lock(rings_mutex);
+                thread_ring.ring = claim_ring();
+            }
+            return *thread_ring.ring;
+        }
+
+        // Rings are never freed, since a crash handler may be reading them: the drained ring of a thread that
+        // exited is reused, and a new one is only allocated when there is none. Called with `rings_mutex` held.
+        Ring* claim_ring() {
+            for (Ring* ring = rings.load(std::memory_order_relaxed); ring != nullptr; ring = ring->next) {
+                // Read `orphaned` before `head`, so an orphaned ring that looks empty really is
+                if (ring->orphaned.load(std::memory_order_acquire) &&
+                    ring->head.load(std::memory_order_relaxed) == ring->tail.load(std::memory_order_relaxed)) {
+                    ring->orphaned.store(false, std::memory_order_relaxed);
+                    return ring;
+                }
+            }
+            Ring* ring = new Ring();
+            ring->next = rings.load(std::memory_order_relaxed);
+            rings.store(ring, std::memory_order_release);
+            return ring;
+        }
+
+        void request_drain() {
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex);
+                wake_requested = true;
+            }
+            wake.notify_one();
+        }
+
+        void run() {
+            while (true) {
+                bool stop_requested;
+                {
+                    std::unique_lock<std::mutex> lock(wake_mutex);
+                    wake.wait_for(lock, POLL_INTERVAL, [this] { return wake_requested || stopping; });
+                    wake_requested = false;
+                    stop_requested = stopping;
+                }
+                // Drain until empty, so that stopping writes out everything appended before the request
+                while (drain() > 0) {}
+                if (stop_requested) {
+                    return;
+                }
+            }
+        }
+
+        // Writes out the current contents of every ring, returning the number of bytes written.
+        size_t drain() {
+            std::array<iovec, 2 * BATCH_RINGS> iov;
+            std::array<Pending, BATCH_RINGS> pending;
+            size_t iov_count = 0;
+            size_t pending_count = 0;
+            size_t total = 0;
+
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            for (Ring* ring = rings.load(std::memory_order_relaxed); ring != nullptr; ring = ring->next) {
+                const size_t head = ring->head.load(std::memory_order_acquire);
+                const size_t tail = ring->tail.load(std::memory_order_relaxed);
+                if (head == tail) {
+                    continue;
+                }
+
+                const size_t offset = tail % Ring::CAPACITY;
+                const size_t length = head - tail;
+                const size_t first = std::min(length, Ring::CAPACITY - offset);
+                if (encoder != nullptr) {
+                    const char* frames = ring->data.data() + offset;
+                    if (first < length) {
+                        wrapped.assign(frames, first);
+                        wrapped.append(ring->data.data(), length - first);
+                        frames = wrapped.data();
+                    }
+                    encode(frames, length);
+                } else {
+                    iov[iov_count++] = { ring->data.data() + offset, first };
+                    if (first < length) {
+                        iov[iov_count++] = { ring->data.data(), length - first };
+                    }
+                }
+                pending[pending_count++] = { ring, head };
+                total += length;
+
+                if (pending_count == BATCH_RINGS) {
+                    flush_batch(iov.data(), iov_count, pending.data(), pending_count);
+                    iov_count = 0;
+                    pending_count = 0;
+                }
+            }
+            flush_batch(iov.data(), iov_count, pending.data(), pending_count);
+            return total;
+        }
+
+        // Encodes the records held in `frames` into `encoded`.
+        void encode(const char* frames, size_t length) {
+            const char* end = frames + length;
+            while (frames != end) {
+                Frame frame;
+                memcpy(&frame, frames, sizeof(Frame));
+                const char* value = frames + sizeof(Frame);
+                if (frame.prefix == nullptr) {
+                    encoder->record(encoded, std::string_view(value, frame.value_sizes[0]));
+                } else {
+                    std::array<antithesis::internal::cbor::Member, antithesis::internal::cbor::MAX_MEMBERS> members;
+                    for (uint32_t i = 0; i < frame.member_count; i++) {
+                        members[i] = { frame.keys[i], std::string_view(value, frame.value_sizes[i]) };
+                        value += frame.value_sizes[i];
+                    }
+                    encoder->site_record(encoded, std::string_view(frame.prefix, frame.prefix_size), members.data(), frame.member_count);
+                }
+                frames += frame.size;
+            }
+        }
+
+        void flush_batch(iovec* iov, size_t iov_count, const Pending* pending, size_t pending_count) {
+            if (encoder != nullptr) {
+                iovec batch{ encoded.data(), encoded.size() };
+                write_fully(&batch, batch.iov_len > 0 ? 1 : 0);
+                encoded.clear();
+            } else {
+                write_fully(iov, iov_count);
+            }
+            for (size_t i = 0; i < pending_count; i++) {
+                pending[i].ring->tail.store(pending[i].head, std::memory_order_release);
+            }
+            if (pending_count > 0 && policy == BLOCK) {
+                notify_space();
+            }
+        }
+
+        // Writes a record synchronously, still as a single write
+        void write_through(const char* message, size_t length) {
+            std::array<iovec, 2> record{ iovec{ const_cast<char*>(message), length }, iovec{ const_cast<char*>("\n"), 1 } };
+            write_fully(record.data(), record.size());
+        }
+
+        // Encodes a CBOR record with `encode` and writes it synchronously
+        template <typename Encode>
+        void encode_through(Encode&& encode) {
+            // The encoder belongs to whoever holds `rings_mutex`
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            std::string record;
+            encode(record);
+            iovec encoded_record{ record.data(), record.size() };
+            write_fully(&encoded_record, 1);
+        }
+
+        void write_fully(iovec* iov, size_t iov_count) {
+            antithesis::internal::handlers::write_fully(fd, iov, iov_count);
+        }
+    };
+    #pragma clang diagnostic pop
+
+    // Random values and version record fields shared by the handlers that run without Antithesis
+    struct LocalRandomHandler : LibHandler {
+        uint64_t random() override {
+            return antithesis::internal::random::local_random();
+        }
+
+        void random_fill(uint64_t* words, size_t count) override {
+            for (size_t i = 0; i < count; i++) {
+                words[i] = antithesis::internal::random::local_random();
+            }
+        }
+
+        // The seed to set to reproduce this run's random values
+        void add_to_version_record(JSON& sdk_record) const override {
+            sdk_record["local_random_seed"] = antithesis::internal::random::get_local_random_seed();
+        }
+    };
+
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+    // A multi-producer, single-consumer ring of records in a POSIX shared-memory segment, so that records reach
+    // a collector in another process without a system call per record. tools/shm_collector.cpp drains it.
+    //
+    // The segment starts with a SharedRingHeader, in native byte order, followed by `capacity` bytes of ring.
+    // `head` counts the bytes ever reserved by producers and `tail` the bytes ever released by the collector;
+    // the ring offset of a count is the count modulo `capacity`, a power of two. Each record is a frame of:
+    //   uint32_t length    bytes of JSON, without a newline
+    //   uint32_t state     0 while the record is being written, 1 once it is complete
+    //   char     json[length], then zeros up to a multiple of 8 bytes
+    // Frames are 8-byte aligned and may wrap around the end of the ring. A producer reserves a frame by moving
+    // `head` with compare-and-swap, copies the record in and then sets `state`; the collector copies complete
+    // frames out in order, zeroes them and moves `tail` past them. A record that does not fit is counted in
+    // `dropped`, or waited for if the ring was opened with BLOCK. The creator of the segment sets `magic` last.
+    // A frame that stays incomplete for a second belongs to a producer that died; the collector skips it.
+    struct SharedRingHeader {
+        static constexpr uint64_t MAGIC = 0x31474E4952544E41ull; // "ANTRING1"
+        static constexpr uint32_t VERSION = 1;
+
+        std::atomic<uint64_t> magic;
+        uint32_t version;
+        // Bytes from the start of the segment to the ring
+        uint32_t header_size;
+        uint64_t capacity;
+        std::atomic<uint64_t> dropped;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+    };
+    static_assert(sizeof(SharedRingHeader) == 192 && std::atomic<uint64_t>::is_always_lock_free);
+
+    struct SharedRing {
+        enum FullPolicy { BLOCK, DROP };
+
+        static constexpr size_t FRAME_HEADER_SIZE = 8;
+        static constexpr uint32_t FRAME_COMPLETE = 1;
+
+        SharedRingHeader* header;
+        char* data;
+        FullPolicy policy;
+
+        static constexpr uint64_t frame_size(size_t length) {
+            return FRAME_HEADER_SIZE + ((length + 7) & ~uint64_t(7));
+        }
+
+        void write(const char* message, size_t length) {
+            const uint64_t capacity = header->capacity;
+            const uint64_t needed = frame_size(length);
+            if (needed > capacity || length > UINT32_MAX) {
+                header->dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            uint64_t head = header->head.load(std::memory_order_relaxed);
+            while (true) {
+                // Acquire pairs with the collector's release of `tail`, so the frame reserved here has been zeroed
+                const uint64_t tail = header->tail.load(std::memory_order_acquire);
+                if (head + needed - tail > capacity) {
+                    if (policy == DROP) {
+                        header->dropped.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+                    std::this_thread::yield();
+                    head = header->head.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (header->head.compare_exchange_weak(head, head + needed, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+
+            const uint64_t offset = head & (capacity - 1);
+            uint32_t* frame = reinterpret_cast<uint32_t*>(data + offset);
+            // Written first, so the collector can skip the frame if this process dies before completing it
+            std::atomic_ref<uint32_t>(frame[0]).store(static_cast<uint32_t>(length), std::memory_order_relaxed);
+            copy_in((offset + FRAME_HEADER_SIZE) & (capacity - 1), message, length);
+            std::atomic_ref<uint32_t>(frame[1]).store(FRAME_COMPLETE, std::memory_order_release);
+        }
+
+        // Maps the segment `name`, creating and initializing it with `capacity` bytes of ring if it doesn't exist.
+        static SharedRing* open(const char* name, uint64_t capacity, FullPolicy policy) {
+            if (capacity < 4096 || (capacity & (capacity - 1)) != 0) {
+                fprintf(stderr, "%s The shared-memory ring size must be a power of two of at least 4096 bytes\n", ERROR_LOG_LINE_PREFIX);
+                return nullptr;
+            }
+            bool created = true;
+            int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+            if (fd < 0 && errno == EEXIST) {
+                created = false;
+                fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+            }
+            if (fd < 0) {
+                fprintf(stderr, "%s Failed to open shared memory %s: %s\n", ERROR_LOG_LINE_PREFIX, name, strerror(errno));
+                return nullptr;
+            }
+
+            if (created) {
+                if (ftruncate(fd, static_cast<off_t>(sizeof(SharedRingHeader) + capacity)) != 0) {
+                    fprintf(stderr, "%s Failed to size shared memory %s: %s\n", ERROR_LOG_LINE_PREFIX, name, strerror(errno));
+                    close(fd);
+                    return nullptr;
+                }
+            } else {
+                // Whoever created the segment may still be sizing it
+                struct stat stat_buf;
+                for (int attempt = 0;; attempt++) {
+                    if (fstat(fd, &stat_buf) != 0) {
+                        fprintf(stderr, "%s Failed to stat shared memory %s: %s\n", ERROR_LOG_LINE_PREFIX, name, strerror(errno));
+                        close(fd);
+                        return nullptr;
+                    }
+                    if (stat_buf.st_size > static_cast<off_t>(sizeof(SharedRingHeader)) || attempt >= 1000) break;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                if (stat_buf.st_size <= static_cast<off_t>(sizeof(SharedRingHeader))) {
+                    fprintf(stderr, "%s Shared memory %s is too small to hold a record ring\n", ERROR_LOG_LINE_PREFIX, name);
+                    close(fd);
+                    return nullptr;
+                }
+                capacity = static_cast<uint64_t>(stat_buf.st_size) - sizeof(SharedRingHeader);
+                if ((capacity & (capacity - 1)) != 0) {
+                    fprintf(stderr, "%s Shared memory %s does not hold a record ring\n", ERROR_LOG_LINE_PREFIX, name);
+                    close(fd);
+                    return nullptr;
+                }
+            }
+
+            void* mapping = mmap(nullptr, sizeof(SharedRingHeader) + capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (mapping == MAP_FAILED) {
+                fprintf(stderr, "%s Failed to map shared memory %s: %s\n", ERROR_LOG_LINE_PREFIX, name, strerror(errno));
+                return nullptr;
+            }
+
+            SharedRingHeader* header = static_cast<SharedRingHeader*>(mapping);
+            if (created) {
+                header->version = SharedRingHeader::VERSION;
+                header->header_size = sizeof(SharedRingHeader);
+                header->capacity = capacity;
+                header->magic.store(SharedRingHeader::MAGIC, std::memory_order_release);
+            } else {
+                for (int attempt = 0; header->magic.load(std::memory_order_acquire) != SharedRingHeader::MAGIC && attempt < 1000; attempt++) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                if (header->magic.load(std::memory_order_acquire) != SharedRingHeader::MAGIC || header->version != SharedRingHeader::VERSION ||
+                    header->header_size != sizeof(SharedRingHeader) || header->capacity != capacity) {
+                    fprintf(stderr, "%s Shared memory %s does not hold a record ring\n", ERROR_LOG_LINE_PREFIX, name);
+                    munmap(mapping, sizeof(SharedRingHeader) + capacity);
+                    return nullptr;
+                }
+            }
+            return new SharedRing{ header, static_cast<char*>(mapping) + sizeof(SharedRingHeader), policy };
+        }
+
+    private:
+        void copy_in(uint64_t offset, const char* bytes, size_t length) {
+            const size_t first = std::min<uint64_t>(length, header->capacity - offset);
+            memcpy(data + offset, bytes, first);
+            memcpy(data, bytes + first, length - first);
+        }
+    };
+    #pragma clang diagnostic pop
+
+    // Writes records into a shared-memory ring named by `ANTITHESIS_SDK_LOCAL_OUTPUT_SHM`, such as
+    // `/antithesis-sdk`, for a collector to drain; see SharedRing. The ring is created if the collector hasn't
+    // created it already, with `ANTITHESIS_SDK_LOCAL_OUTPUT_SHM_SIZE` bytes (4 MiB by default). Records that
+    // don't fit are dropped and counted, unless `ANTITHESIS_SDK_LOCAL_OUTPUT_SHM_FULL` is `block`. Records are
+    // always JSON, whatever `ANTITHESIS_SDK_LOCAL_OUTPUT_FORMAT` says.
+    struct SharedMemoryHandler final : LocalRandomHandler {
+        static constexpr uint64_t DEFAULT_CAPACITY = 4 * 1024 * 1024;
+
+        void output(const char* message, size_t length) const override {
+            if (message != nullptr) {
+                ring->write(message, length);
+            }
+        }
+
+        static std::unique_ptr<SharedMemoryHandler> create() {
+            const char* name = std::getenv(LOCAL_OUTPUT_SHM_ENVIRONMENT_VARIABLE);
+            if (!name || !name[0]) {
+                return nullptr;
+            }
+
+            uint64_t capacity = DEFAULT_CAPACITY;
+            const char* size = std::getenv(LOCAL_OUTPUT_SHM_SIZE_ENVIRONMENT_VARIABLE);
+            if (size && size[0]) {
+                capacity = strtoull(size, nullptr, 0);
+            }
+
+            SharedRing::FullPolicy policy = SharedRing::DROP;
+            const char* full = std::getenv(LOCAL_OUTPUT_SHM_FULL_ENVIRONMENT_VARIABLE);
+            if (full && strcmp(full, "block") == 0) {
+                policy = SharedRing::BLOCK;
+            } else if (full && full[0] && strcmp(full, "drop") != 0) {
+                fprintf(stderr, "%s Unknown value for %s: %s\n", ERROR_LOG_LINE_PREFIX, LOCAL_OUTPUT_SHM_FULL_ENVIRONMENT_VARIABLE, full);
+            }
+
+            // Leaked with the handler, so that records emitted late during exit are still accepted
+            SharedRing* ring = SharedRing::open(name, capacity, policy);
+            if (ring == nullptr) {
+                return nullptr;
+            }
+            return std::unique_ptr<SharedMemoryHandler>(new SharedMemoryHandler(ring));
+        }
+
+    private:
+        SharedRing* ring;
+
+        explicit SharedMemoryHandler(SharedRing* ring) : ring(ring) {}
+    };
+
+    // Defined with the assertion helpers below
+    inline void start_child_output(LibHandler& handler);
+
+    struct LocalHandler final : LocalRandomHandler {
         ~LocalHandler() override {
-            if (file != nullptr) {
-                fclose(file);
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        // Each record, with its newline, is written by a single writev to a file opened with O_APPEND, so
+        // records from several threads or processes never interleave, and nothing is left in a buffer to fork.
+        void output(const char* message, size_t length) const override {
+            if (message == nullptr || fd < 0) {
+                return;
+            }
+            if (encoder != nullptr) {
+                // The SDK's own records don't come through here when the output is CBOR; one that does is
+                // kept as the text it was given
+                std::string record;
+                antithesis::internal::cbor::CBORWriter writer(record);
+                writer.isolate();
+                writer.string(std::string_view(message, length));
+                output_encoded(record);
+            } else if (async_writer != nullptr) {
+                async_writer->write(message, length);
+            } else {
+                std::array<iovec, 2> record{ iovec{ const_cast<char*>(message), length }, iovec{ const_cast<char*>("\n"), 1 } };
+                write_fully(fd, record.data(), record.size());
+            }
+        }
+
+        // The handler that SDK records go to, instead of `output`, when the output is CBOR, so that they are
+        // encoded straight from their values and prerendered prefixes; see CBOREncoder
+        static const LocalHandler* cbor_output() {
+            return instance != nullptr && instance->encoder != nullptr ? instance : nullptr;
+        }
+
+        // Outputs the record of an assertion or guidepost site as CBOR. A site already seen in the open
+        // namespace is written under a shared lock, so threads only wait for each other when a site is new.
+        void output_site_record(std::string_view prefix, const antithesis::internal::cbor::Member* members, size_t count) const {
+            if (fd < 0) {
+                return;
+            }
+            if (async_writer != nullptr) {
+                async_writer->write_site_record(prefix, members, count);
+                return;
+            }
+            {
+                std::shared_lock<std::shared_mutex> lock(encoder_mutex);
+                std::array<std::string_view, 2 + 2 * antithesis::internal::cbor::MAX_MEMBERS> parts;
+                const size_t part_count = encoder->gather(prefix, members, count, parts.data());
+                if (part_count > 0) {
+                    std::array<iovec, 2 + 2 * antithesis::internal::cbor::MAX_MEMBERS> record;
+                    for (size_t i = 0; i < part_count; i++) {
+                        record[i] = iovec{ const_cast<char*>(parts[i].data()), parts[i].size() };
+                    }
+                    write_fully(fd, record.data(), part_count);
+                    return;
+                }
+            }
+            std::lock_guard<std::shared_mutex> lock(encoder_mutex);
+            encoded.clear();
+            encoder->site_record(encoded, prefix, members, count);
+            iovec record{ encoded.data(), encoded.size() };
+            write_fully(fd, &record, 1);
+        }
+
+        // Outputs a CBOR record that makes no use of the stringref table, such as one encoded by
+        // CBORWriter::isolated_object.
+        void output_encoded(std::string_view record) const {
+            if (fd < 0) {
+                return;
+            }
+            if (async_writer != nullptr) {
+                async_writer->write_encoded(record);
+                return;
+            }
+            {
+                std::shared_lock<std::shared_mutex> lock(encoder_mutex);
+                if (encoder->is_open()) {
+                    iovec encoded_record{ const_cast<char*>(record.data()), record.size() };
+                    write_fully(fd, &encoded_record, 1);
+                    return;
+                }
+            }
+            std::lock_guard<std::shared_mutex> lock(encoder_mutex);
+            encoded.clear();
+            encoder->record(encoded, record);
+            iovec encoded_record{ encoded.data(), encoded.size() };
+            write_fully(fd, &encoded_record, 1);
+        }
+
+        // Records are written as they are output, unless the async writer holds them
+        void emergency_flush(char* scratch, size_t scratch_size) const override {
+            if (async_writer != nullptr) {
+                async_writer->emergency_drain(scratch, scratch_size);
+            }
+        }
+
+        // If `ANTITHESIS_SDK_LOCAL_OUTPUT` is set to a non-empty path, records are appended to that file;
+        // otherwise logging is a no-op in the local handler. Each `%p` in the path is replaced by the process
+        // id, giving every process, including forked children, a file of its own.
+        static std::unique_ptr<LocalHandler> create() {
+            const char* path = std::getenv(LOCAL_OUTPUT_ENVIRONMENT_VARIABLE);
+            if (!path || !path[0]) {
+                return std::unique_ptr<LocalHandler>(new LocalHandler(-1, ""));
+            }
+            const std::string path_template = path;
+            return std::unique_ptr<LocalHandler>(new LocalHandler(open_output(expand_path(path_template)), path_template));
+        }
+
+    private:
+        int fd;
+        // The path as given, before `%p` is expanded
+        std::string path_template;
+        // Set when records are written as CBOR. It is used under `encoder_mutex`, shared only to gather
+        // records, or by the async writer.
+        antithesis::internal::cbor::CBOREncoder* encoder;
+        mutable std::shared_mutex encoder_mutex;
+        mutable std::string encoded;
+        // Leaked on exit like the handler itself, so that records emitted late during exit are still accepted
+        AsyncWriter* async_writer;
+
+        // The one handler with an output file, which the fork and exit handlers below act on
+        static inline LocalHandler* instance = nullptr;
+
+        LocalHandler(int fd, std::string path_template): fd(fd), path_template(std::move(path_template)),
+            encoder(nullptr), async_writer(nullptr) {
+            if (fd < 0) {
+                return;
+            }
+            instance = this;
+            encoder = create_encoder();
+            async_writer = create_async_writer(fd, encoder);
+            // A read-write lock can only be unlocked by the thread that took it, which the child's thread is not,
+            // so the child gets a new one
+            pthread_atfork([] { instance->encoder_mutex.lock(); }, [] { instance->encoder_mutex.unlock(); },
+                [] { new (&instance->encoder_mutex) std::shared_mutex(); instance->restart_in_child(); });
+        }
+
+        // A forked child writes into its parent's file, unless the path has `%p` or the output is CBOR, which
+        // is a single stream that only one process can write. Such a child starts a file of its own, named
+        // after its process id, which stands alone: first hits are reported again, after the version record
+        // and catalog. The child writes synchronously, since the async writer's thread was not forked.
+        void restart_in_child() {
+            if (async_writer != nullptr) {
+                async_writer->abandon();
+                async_writer = nullptr;
+            }
+            const bool per_process = path_template.find("%p") != std::string::npos;
+            if (!per_process && encoder == nullptr) {
+                return;
+            }
+            const std::string path = per_process ? expand_path(path_template) : path_template + "." + std::to_string(getpid());
+            const int child_fd = open_output(path);
+            close(fd);
+            fd = child_fd;
+            if (fd < 0) {
+                return;
+            }
+            if (encoder != nullptr) {
+                encoder = new antithesis::internal::cbor::CBOREncoder();
+            }
+            start_child_output(*this);
+        }
+
+        static std::string expand_path(const std::string& path_template) {
+            std::string path;
+            for (size_t i = 0; i < path_template.size(); i++) {
+                if (path_template[i] == '%' && i + 1 < path_template.size() && path_template[i + 1] == 'p') {
+                    path += std::to_string(getpid());
+                    i++;
+                } else {
+                    path += path_template[i];
+                }
+            }
+            return path;
+        }
+
+        // If `ANTITHESIS_SDK_LOCAL_OUTPUT_FORMAT` is `cbor`, records are written as CBOR rather than as lines
+        // of JSON; see CBOREncoder. The encoding is completed at exit.
+        static antithesis::internal::cbor::CBOREncoder* create_encoder() {
+            const char* format = std::getenv(LOCAL_OUTPUT_FORMAT_ENVIRONMENT_VARIABLE);
+            if (!format || !format[0] || strcmp(format, "json") == 0) {
+                return nullptr;
+            }
+            if (strcmp(format, "cbor") != 0) {
+                fprintf(stderr, "%s Unknown value for %s: %s\n", ERROR_LOG_LINE_PREFIX, LOCAL_OUTPUT_FORMAT_ENVIRONMENT_VARIABLE, format);
+                return nullptr;
+            }
+
+            // Registered before the async writer's handler, so it runs after everything has been drained
+            atexit([] {
+                std::string end;
+                std::lock_guard<std::shared_mutex> lock(instance->encoder_mutex);
+                instance->encoder->finish(end);
+                iovec record{ end.data(), end.size() };
+                write_fully(instance->fd, &record, end.empty() ? 0 : 1);
+            });
+            return new antithesis::internal::cbor::CBOREncoder();
+        }
+
+        // If `ANTITHESIS_SDK_LOCAL_OUTPUT_ASYNC` is set to `block` or `drop`, records are written by a
+        // background thread, and a full per-thread buffer either blocks the emitting thread or drops the record.
+        // Anything buffered is written out at exit.
+        static AsyncWriter* create_async_writer(int fd, antithesis::internal::cbor::CBOREncoder* encoder) {
+            const char* mode = std::getenv(LOCAL_OUTPUT_ASYNC_ENVIRONMENT_VARIABLE);
+            if (!mode || !mode[0]) {
+                return nullptr;
+            }
+
+            AsyncWriter::FullPolicy policy;
+            if (strcmp(mode, "block") == 0) {
+                policy = AsyncWriter::BLOCK;
+            } else if (strcmp(mode, "drop") == 0) {
+                policy = AsyncWriter::DROP;
+            } else {
+                fprintf(stderr, "%s Unknown value for %s: %s\n", ERROR_LOG_LINE_PREFIX, LOCAL_OUTPUT_ASYNC_ENVIRONMENT_VARIABLE, mode);
+                return nullptr;
+            }
+
+            static AsyncWriter* writer = nullptr;
+            writer = new AsyncWriter(fd, policy, encoder);
+            atexit([] { writer->stop(); });
+            return writer;
+        }
+
+        // Opens `path` for appending, creating it if needed. The file is truncated only by a process that finds
+        // no other process holding it open: every process keeps a shared flock on it, so a process starting
+        // while others are writing joins their file rather than wiping it.
+        static int open_output(const std::string& path) {
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                fprintf(stderr, "%s Failed to open path %s: %s\n", ERROR_LOG_LINE_PREFIX, path.c_str(), strerror(errno));
+                return -1;
+            }
+            struct stat stat_buf;
+            if (fstat(fd, &stat_buf) == 0 && S_ISREG(stat_buf.st_mode) && flock(fd, LOCK_EX | LOCK_NB) == 0) {
+                if (ftruncate(fd, 0) != 0) {
+                    fprintf(stderr, "%s Failed to truncate path %s: %s\n", ERROR_LOG_LINE_PREFIX, path.c_str(), strerror(errno));
+                }
+            }
+            flock(fd, LOCK_SH);
+            int ret = fchmod(fd, 0644);
+            if (ret != 0) {
+                fprintf(stderr, "%s Failed to set permissions for path %s: %s\n", ERROR_LOG_LINE_PREFIX, path.c_str(), strerror(errno));
+                close(fd);
+                return -1;
+            }
+
+            return fd;
+        }
+    };
+}
+
+// A handler bound with ANTITHESIS_SDK_HANDLER that isn't built in is defined here, once the built-in ones are
+#ifdef ANTITHESIS_SDK_HANDLER_HEADER
+    #include ANTITHESIS_SDK_HANDLER_HEADER
+#endif
+
+namespace antithesis::internal::handlers {
+    // The type of the handler the SDK emits through. By default it is the Handler interface, and every record
+    // costs a virtual call. Defining ANTITHESIS_SDK_HANDLER binds a handler at compile time instead, so that
+    // `output` and `random` are called directly and can be inlined. It names a `final` class derived from
+    // antithesis::Handler, with a `static std::unique_ptr<T> create()` that returns the handler to use; the
+    // built-in ones are antithesis::internal::handlers::AntithesisHandler and ...::LocalHandler. Any other has
+    // to be defined in a header named by ANTITHESIS_SDK_HANDLER_HEADER, which is included just above.
+#ifdef ANTITHESIS_SDK_HANDLER
+    using SelectedHandler = ANTITHESIS_SDK_HANDLER;
+    static_assert(std::is_base_of_v<LibHandler, SelectedHandler> && std::is_final_v<SelectedHandler>,
+        "ANTITHESIS_SDK_HANDLER must name a final class derived from antithesis::Handler");
+#else
+    using SelectedHandler = LibHandler;
+#endif
+
+    // A handler registered by antithesis::set_handler, until the SDK initializes and takes it
+    inline std::mutex registered_handler_mutex;
+    inline LibHandler* registered_handler = nullptr;
+    inline bool handler_taken = false;
+
+    inline LibHandler* take_registered_handler() {
+        std::lock_guard<std::mutex> lock(registered_handler_mutex);
+        handler_taken = true;
+        return registered_handler;
+    }
+
+    // If `ANTITHESIS_SDK_CRASH_FLUSH` is set, the handler's `emergency_flush` runs when the process dies of a
+    // fatal signal or std::terminate, so that records buffered by the async writer or a flush threshold, often
+    // the ones that explain the crash, still come out. Everything it needs is allocated when it is installed.
+    // The dispositions and terminate handler that were installed before are kept and run afterwards, so the
+    // process still dies, or is handled, as it would have been. The alternate signal stack, which lets a stack
+    // overflow be handled, is set up for the thread that initializes the SDK and for every other thread when it
+    // first emits a record; a thread that overflows its stack before emitting anything dies without the flush.
+    struct CrashHandler {
+        static constexpr std::array<int, 7> SIGNALS = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT, SIGTRAP, SIGSYS };
+        static constexpr size_t SCRATCH_SIZE = 128 * 1024;
+        static constexpr size_t ALTERNATE_STACK_SIZE = 64 * 1024;
+
+        static void install(const LibHandler* crash_handler) {
+            handler = crash_handler;
+            scratch = new char[SCRATCH_SIZE];
+
+            add_thread_stack();
+            antithesis::internal::json::on_thread_buffer_created = add_thread_stack;
+
+            struct sigaction action{};
+            action.sa_sigaction = on_signal;
+            action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+            sigemptyset(&action.sa_mask);
+            for (size_t i = 0; i < SIGNALS.size(); i++) {
+                sigaction(SIGNALS[i], &action, &previous_actions[i]);
+            }
+            previous_terminate = std::set_terminate(on_terminate);
+        }
+
+    private:
+        static inline const LibHandler* handler = nullptr;
+        static inline char* scratch = nullptr;
+        // Set by the first crash, so that a signal raised while flushing, or after std::terminate, doesn't flush again
+        static inline std::atomic<bool> flushed{false};
+        static inline std::array<struct sigaction, SIGNALS.size()> previous_actions{};
+        static inline std::terminate_handler previous_terminate = nullptr;
+
+        // Gives the calling thread an alternate signal stack, unless it already has one. It is taken down and
+        // freed when the thread exits.
+        static void add_thread_stack() {
+            struct ThreadStack {
+                char* stack = nullptr;
+                ~ThreadStack() {
+                    stack_t current_stack;
+                    if (stack != nullptr && sigaltstack(nullptr, &current_stack) == 0 && current_stack.ss_sp == stack) {
+                        stack_t disabled{};
+                        disabled.ss_flags = SS_DISABLE;
+                        sigaltstack(&disabled, nullptr);
+                        delete[] stack;
+                    }
+                    stack = nullptr;
+                }
+            };
+            thread_local ThreadStack thread_stack;
+            stack_t current_stack;
+            if (thread_stack.stack == nullptr && sigaltstack(nullptr, &current_stack) == 0 && (current_stack.ss_flags & SS_DISABLE) != 0) {
+                stack_t alternate_stack{};
+                alternate_stack.ss_sp = new char[ALTERNATE_STACK_SIZE];
+                alternate_stack.ss_size = ALTERNATE_STACK_SIZE;
+                if (sigaltstack(&alternate_stack, nullptr) == 0) {
+                    thread_stack.stack = static_cast<char*>(alternate_stack.ss_sp);
+                } else {
+                    delete[] static_cast<char*>(alternate_stack.ss_sp);
+                }
             }
         }
 
-        void output(const char* message) const override {
-            if (file != nullptr && message != nullptr) {
-                fprintf(file, "%s\n", message);
+        static bool flush_once() {
+            if (flushed.exchange(true)) {
+                return false;
             }
+            handler->emergency_flush(scratch, SCRATCH_SIZE);
+            return true;
         }
 
-        uint64_t random() override {
-            return random_gen.random();
-        }
-
-        static std::unique_ptr<LocalHandler> create() {
-            return std::unique_ptr<LocalHandler>(new LocalHandler(create_internal()));
-        }
-    private:
-        FILE* file;
-        antithesis::internal::random::LocalRandom random_gen;
-
-        LocalHandler(FILE* file): file(file), random_gen() {
-        }
+        static void on_signal(int signal_number, siginfo_t* info, void* context) {
+            const auto found = std::find(SIGNALS.begin(), SIGNALS.end(), signal_number);
+            const struct sigaction& previous = previous_actions[static_cast<size_t>(found - SIGNALS.begin())];
+            const bool is_handler = (previous.sa_flags & SA_SIGINFO) != 0 || (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN);
+            // A fault raised by the kernel can't be ignored, since it happens again as soon as this returns
+            const bool is_fault = info != nullptr && info->si_code > 0 &&
+                (signal_number == SIGSEGV || signal_number == SIGBUS || signal_number == SIGFPE || signal_number == SIGILL);
+            if (!is_handler && previous.sa_handler == SIG_IGN && !is_fault) {
+                return; // The process carries on, as it would have
+            }
 
-        // If `localOutputEnvVar` is set to a non-empty path, attempt to open that path and truncate the file
-        // to serve as the log file of the local handler.
-        // Otherwise, we don't have a log file, and logging is a no-op in the local handler.
-        static FILE* create_internal() {
-            const char* path = std::getenv(LOCAL_OUTPUT_ENVIRONMENT_VARIABLE);
-            if (!path || !path[0]) {
-                return nullptr;
+            flush_once();
+            if ((previous.sa_flags & SA_SIGINFO) != 0) {
+                previous.sa_sigaction(signal_number, info, context);
+            } else if (is_handler) {
+                previous.sa_handler(signal_number);
+            } else {
+                // The signal is blocked until this returns, and then takes its default course; a fault simply
+                // happens again on return
+                struct sigaction restored = previous;
+                restored.sa_handler = SIG_DFL;
+                sigaction(signal_number, &restored, nullptr);
+                raise(signal_number);
             }
+        }
 
-            // Open the file for writing (create if needed and possible) and truncate it
-            FILE* file = fopen(path, "w");
-            if (file == nullptr) {
-                fprintf(stderr, "%s Failed to open path %s: %s\n", ERROR_LOG_LINE_PREFIX, path, strerror(errno));
-                return nullptr;
+        [[noreturn]] static void on_terminate() {
+            // Not a signal handler, so the handler's ordinary flush may run as well
+            if (flush_once()) {
+                handler->flush();
             }
-            int ret = fchmod(fileno(file), 0644);
-            if (ret != 0) {
-                fprintf(stderr, "%s Failed to set permissions for path %s: %s\n", ERROR_LOG_LINE_PREFIX, path, strerror(errno));
-                fclose(file);
-                return nullptr;
+            if (previous_terminate != nullptr) {
+                previous_terminate();
             }
-
-            return file;
+            abort();
         }
     };
 
-    static std::unique_ptr<LibHandler> init() {
+    static std::unique_ptr<SelectedHandler> init() {
+#ifdef ANTITHESIS_SDK_HANDLER
+        std::unique_ptr<SelectedHandler> handler = SelectedHandler::create();
+        if (!handler) {
+            fprintf(stderr, "%s Failed to create the handler given by ANTITHESIS_SDK_HANDLER\n", ERROR_LOG_LINE_PREFIX);
+            exit(-1);
+        }
+        return handler;
+#else
+        if (LibHandler* registered = take_registered_handler()) {
+            return std::unique_ptr<LibHandler>(registered);
+        }
+
         struct stat stat_buf;
-        if (stat(LIB_PATH, &stat_buf) == 0) {
+        const char* lib_path = get_lib_path();
+        if (stat(lib_path, &stat_buf) == 0) {
             std::unique_ptr<LibHandler> tmp = AntithesisHandler::create();
             if (!tmp) {
                 fprintf(stderr, "%s Failed to create handler for Antithesis library\n", ERROR_LOG_LINE_PREFIX);
@@ -364,29 +2537,65 @@ namespace antithesis::internal::handlers {
             }
             return tmp;
         } else {
+            if (lib_path != LIB_PATH) {
+                fprintf(stderr, "%s Can not find %s from %s: %s; running locally\n", ERROR_LOG_LINE_PREFIX, lib_path,
+                    LIB_PATH_ENVIRONMENT_VARIABLE, strerror(errno));
+            }
+            if (std::unique_ptr<LibHandler> shared_memory = SharedMemoryHandler::create()) {
+                return shared_memory;
+            }
             return LocalHandler::create();
         }
+#endif
     }
 
-    inline LibHandler& get_lib_handler() {
-        static LibHandler* lib_handler = nullptr;
-        if (lib_handler == nullptr) {
-            lib_handler = init().release(); // Leak on exit, rather than exit-time-destructor
-
-            JSON language_block{
-              {"name", "C++"},
-              {"version", __VERSION__}
-            };
+    // Defined with the assertion helpers below
+    inline void emit_catalog(LibHandler& handler);
 
-            JSON version_message{
-                {"antithesis_sdk", JSON{
-                    {"language", language_block},
-                    {"sdk_version", SDK_VERSION},
-                    {"protocol_version", PROTOCOL_VERSION}
-                }
-            }};
-            lib_handler->output(version_message);
+    inline void output_json(const LibHandler& handler, const JSON& json) {
+        std::string& buffer = get_thread_buffer();
+        if (const LocalHandler* cbor_output = LocalHandler::cbor_output()) {
+            antithesis::internal::cbor::CBORWriter(buffer).isolated_object(json);
+            cbor_output->output_encoded(buffer);
+            return;
         }
+        JSONWriter(buffer).object(json);
+        handler.output(buffer.data(), buffer.size());
+    }
+
+    inline void emit_version_record(LibHandler& handler) {
+        JSON language_block{
+          {"name", "C++"},
+          {"version", __VERSION__}
+        };
+
+        JSON sdk_record{
+            {"language", language_block},
+            {"sdk_version", SDK_VERSION},
+            {"protocol_version", PROTOCOL_VERSION}
+        };
+        handler.add_to_version_record(sdk_record);
+
+        JSON version_message{
+            {"antithesis_sdk", sdk_record}
+        };
+        output_json(handler, version_message);
+    }
+
+    inline SelectedHandler& get_lib_handler() {
+        // Created exactly once, even if several threads emit their first record at the same time
+        static SelectedHandler* lib_handler = [] {
+            SelectedHandler* handler = init().release(); // Leak on exit, rather than exit-time-destructor
+            atexit([] { lib_handler->flush(); });
+            const char* crash_flush = std::getenv(CRASH_FLUSH_ENVIRONMENT_VARIABLE);
+            if (crash_flush && crash_flush[0]) {
+                CrashHandler::install(handler);
+            }
+
+            emit_version_record(*handler);
+            emit_catalog(*handler);
+            return handler;
+        }();
 
         return *lib_handler;
     }
@@ -400,15 +2609,38 @@ namespace antithesis::internal::handlers {
 
 #ifndef NO_ANTITHESIS_SDK
 
+#include <atomic>
+#include <bit>
+
 namespace antithesis::internal::assertions {
     using namespace antithesis::internal::handlers;
 
+    // Tracks which outcomes of an assertion have not been emitted yet, as bits of a single atomic word.
+    // Clearing a bit is the claim to emit that outcome, so each one is emitted by exactly one thread.
     struct AssertionState {
-        uint8_t false_not_seen : 1;
-        uint8_t true_not_seen : 1;
-        uint8_t rest : 6;
+        static constexpr uint8_t FALSE_NOT_SEEN = 1 << 0;
+        static constexpr uint8_t TRUE_NOT_SEEN = 1 << 1;
+
+        std::atomic<uint8_t> not_seen;
+
+        constexpr AssertionState() : not_seen(FALSE_NOT_SEEN | TRUE_NOT_SEEN) {}
+
+        [[clang::always_inline]] inline bool any_not_seen() const {
+            return not_seen.load(std::memory_order_relaxed) != 0;
+        }
+
+        bool claim(uint8_t outcome) {
+            // Skip the read-modify-write when the outcome was already claimed, so that threads
+            // repeatedly hitting a seen outcome of a pending assertion don't contend on the cache line.
+            if ((not_seen.load(std::memory_order_relaxed) & outcome) == 0) {
+                return false;
+            }
+            return (not_seen.fetch_and(static_cast<uint8_t>(~outcome), std::memory_order_relaxed) & outcome) != 0;
+        }
 
-        AssertionState() : false_not_seen(true), true_not_seen(true), rest(0)  {}
+        void reset() {
+            not_seen.store(FALSE_NOT_SEEN | TRUE_NOT_SEEN, std::memory_order_relaxed);
+        }
     };
 
     enum AssertionType {
@@ -470,10 +2702,72 @@ namespace antithesis::internal::assertions {
                 {"begin_column", column},
             };
         }
+
+        template <typename Writer>
+        constexpr void render(Writer& writer) const {
+            writer.raw("{\"class\":");
+            writer.string(class_name);
+            writer.raw(",\"function\":");
+            writer.string(function_name);
+            writer.raw(",\"file\":");
+            writer.string(file_name);
+            writer.raw(",\"begin_line\":");
+            writer.number(line);
+            writer.raw(",\"begin_column\":");
+            writer.number(column);
+            writer.raw('}');
+        }
     };
 
-    inline std::string make_key([[maybe_unused]] const char* message, const LocationInfo& location_info) {
-        return message;
+    // Renders the part of an assertion record that is fixed for a given assertion site:
+    // everything except `hit`, `condition` and `details`, and without the closing braces.
+    template <typename Writer>
+    constexpr void render_assertion_prefix(Writer& writer, AssertionType type, const char* message, const LocationInfo& location) {
+        writer.raw("{\"antithesis_assert\":{\"assert_type\":");
+        writer.string(get_assert_type_string(type));
+        writer.raw(",\"display_type\":");
+        writer.string(get_display_type_string(type));
+        writer.raw(",\"message\":");
+        writer.string(message);
+        writer.raw(",\"id\":");
+        writer.string(message);
+        writer.raw(",\"location\":");
+        location.render(writer);
+        writer.raw(get_must_hit(type) ? ",\"must_hit\":true" : ",\"must_hit\":false");
+    }
+
+    // Completes an assertion record started by `render_assertion_prefix`.
+    inline void render_assertion(std::string& buffer, std::string_view record_prefix, bool hit, bool cond, const JSON& details) {
+        JSONWriter writer(buffer);
+        writer.raw(record_prefix);
+        writer.raw(hit ? ",\"hit\":true" : ",\"hit\":false");
+        writer.raw(cond ? ",\"condition\":true" : ",\"condition\":false");
+        writer.raw(",\"details\":");
+        writer.object(details);
+        writer.raw("}}");
+    }
+
+    // The CBOR counterpart of `render_assertion`: `details` is encoded into `buffer`, and `output` adds the
+    // rest of the record.
+    inline void output_assertion(const LocalHandler& output, std::string& buffer, std::string_view record_prefix, bool hit, bool cond, const JSON& details) {
+        antithesis::internal::cbor::CBORWriter(buffer).isolated_object(details);
+        const std::array<antithesis::internal::cbor::Member, 3> members{{
+            { antithesis::internal::cbor::HIT_KEY, antithesis::internal::cbor::encoded_bool(hit) },
+            { antithesis::internal::cbor::CONDITION_KEY, antithesis::internal::cbor::encoded_bool(cond) },
+            { antithesis::internal::cbor::DETAILS_KEY, buffer },
+        }};
+        output.output_site_record(record_prefix, members.data(), members.size());
+    }
+
+    inline void emit_assertion(std::string_view record_prefix, bool hit, bool cond, const JSON& details) {
+        SelectedHandler& handler = get_lib_handler();
+        std::string& buffer = get_thread_buffer();
+        if (const LocalHandler* cbor_output = LocalHandler::cbor_output()) {
+            output_assertion(*cbor_output, buffer, record_prefix, hit, cond, details);
+            return;
+        }
+        render_assertion(buffer, record_prefix, hit, cond, details);
+        handler.output(buffer.data(), buffer.size());
     }
 
     inline void assert_impl(bool cond, const char* message, const JSON& details, const LocationInfo& location_info,
@@ -491,7 +2785,7 @@ namespace antithesis::internal::assertions {
                 {"details", details},
             }}
         };
-        antithesis::internal::handlers::get_lib_handler().output(assertion);
+        output_json(antithesis::internal::handlers::get_lib_handler(), assertion);
     }
 
     inline void assert_raw(bool cond, const char* message, const JSON& details, 
@@ -501,72 +2795,135 @@ namespace antithesis::internal::assertions {
         assert_impl(cond, message, details, location_info, hit, must_hit, assert_type, display_type, id);
     }
 
-    typedef std::set<std::string> CatalogEntryTracker;
+    // Assertions are identified by their message. The 64-bit FNV-1a hash of the message is computed at
+    // compile time for each assertion site, and is what the catalog deduplicates on.
+    inline constexpr uint64_t make_key(std::string_view message) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (char c : message) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    // Open-addressing set of the keys of assertions already added to the catalog.
+    // The inline table holds the assertions of typical binaries without allocating; past 3/4 load it
+    // moves to a larger heap table, which is leaked on exit rather than having an exit-time destructor.
+    struct CatalogEntryTracker {
+        static constexpr size_t INLINE_CAPACITY = 16384;
+
+        // Returns true if `key` was not tracked before.
+        bool insert(uint64_t key) {
+            key = (key == 0) ? 1 : key; // 0 marks an empty slot
+            if ((size + 1) * 4 > capacity * 3) {
+                grow();
+            }
+            uint64_t* slots = get_slots();
+            for (size_t i = key & (capacity - 1); ; i = (i + 1) & (capacity - 1)) {
+                if (slots[i] == key) {
+                    return false;
+                }
+                if (slots[i] == 0) {
+                    slots[i] = key;
+                    size++;
+                    return true;
+                }
+            }
+        }
+
+        void clear() {
+            std::fill_n(get_slots(), capacity, 0);
+            size = 0;
+        }
+
+    private:
+        std::array<uint64_t, INLINE_CAPACITY> inline_slots{};
+        uint64_t* heap_slots = nullptr;
+        size_t capacity = INLINE_CAPACITY;
+        size_t size = 0;
+
+        uint64_t* get_slots() {
+            return heap_slots != nullptr ? heap_slots : inline_slots.data();
+        }
+
+        void grow() {
+            uint64_t* old_slots = get_slots();
+            const size_t old_capacity = capacity;
+            capacity *= 2;
+            uint64_t* new_slots = new uint64_t[capacity]();
+            for (size_t i = 0; i < old_capacity; i++) {
+                const uint64_t key = old_slots[i];
+                if (key == 0) {
+                    continue;
+                }
+                size_t j = key & (capacity - 1);
+                while (new_slots[j] != 0) {
+                    j = (j + 1) & (capacity - 1);
+                }
+                new_slots[j] = key;
+            }
+            delete[] heap_slots;
+            heap_slots = new_slots;
+        }
+    };
 
     inline CatalogEntryTracker& get_catalog_entry_tracker() {
-        static CatalogEntryTracker catalog_entry_tracker;
+        static constinit CatalogEntryTracker catalog_entry_tracker;
         return catalog_entry_tracker;
     }
 
+    // Compile-time description of an assertion or guidepost site, from which its catalog record is emitted.
+    // Every CatalogRecord is placed in the `antithesis_catalog` section, so the catalog of a whole module
+    // is collected without running any code per site during static initialization.
+    struct CatalogRecord {
+        enum Kind : uint32_t { ASSERTION_RECORD, GUIDANCE_RECORD };
+
+        Kind kind;
+        // The `condition` reported for an assertion in the catalog
+        bool catalog_condition;
+        // Deduplicates the catalog; see `make_key`
+        uint64_t key;
+        // Pre-rendered by `render_assertion_prefix` or `render_guidance_prefix`
+        std::string_view record_prefix;
+    };
+
     struct Assertion {
         AssertionState state;
-        AssertionType type;
-        const char* message;
-        LocationInfo location;
-
-        Assertion(const char* message, AssertionType type, LocationInfo&& location) : 
-            state(), type(type), message(message), location(std::move(location)) { 
-            this->add_to_catalog();
-        }
+        const CatalogRecord* record;
 
-        void add_to_catalog() const {
-            std::string id = make_key(message, location);
-            CatalogEntryTracker& tracker = get_catalog_entry_tracker();
-            if (!tracker.contains(id)) {
-                tracker.insert(id);
-                const bool condition = (type == REACHABLE_ASSERTION ? true : false);
-                const bool hit = false;
-                const char* assert_type = get_assert_type_string(type);
-                const bool must_hit = get_must_hit(type);
-                const char* display_type = get_display_type_string(type);
-                assert_impl(condition, message, {}, location, hit, must_hit, assert_type, display_type, id.c_str());
-            }
-        }
+        constexpr Assertion(const CatalogRecord* record) : state(), record(record) {}
 
-        [[clang::always_inline]] inline void check_assertion(auto&& cond, const JSON& details)
-            requires requires { static_cast<bool>(std::forward<decltype(cond)>(cond)); } {
+        // `make_details` is only invoked when a record is actually emitted, so once both outcomes
+        // have been seen an assertion with details costs the same as one without.
+        [[clang::always_inline]] inline void check_assertion(auto&& cond, auto&& make_details)
+            requires requires { static_cast<bool>(std::forward<decltype(cond)>(cond)); JSON(make_details()); } {
             #if defined(NO_ANTITHESIS_SDK)
               #error "Antithesis SDK has been disabled"
             #endif
-            if (__builtin_expect(state.false_not_seen || state.true_not_seen, false)) {
-                check_assertion_internal(static_cast<bool>(std::forward<decltype(cond)>(cond)), details);
+            if (__builtin_expect(state.any_not_seen(), false)) {
+                check_assertion_internal(static_cast<bool>(std::forward<decltype(cond)>(cond)), make_details);
             }
         }
 
         private:
-        void check_assertion_internal(bool cond, const JSON& details) {
-            bool emit = false;
-            if (!cond && state.false_not_seen) {
-                emit = true;
-                state.false_not_seen = false;   // TODO: is the race OK?
-            }
-
-            if (cond && state.true_not_seen) {
-                emit = true;
-                state.true_not_seen = false;   // TODO: is the race OK?
-            }
-
-            if (emit) {
+        void check_assertion_internal(bool cond, auto&& make_details) {
+            if (state.claim(cond ? AssertionState::TRUE_NOT_SEEN : AssertionState::FALSE_NOT_SEEN)) {
                 const bool hit = true;
-                const char* assert_type = get_assert_type_string(type);
-                const bool must_hit = get_must_hit(type);
-                const char* display_type = get_display_type_string(type);
-                std::string id = make_key(message, location);
-                assert_impl(cond, message, details, location, hit, must_hit, assert_type, display_type, id.c_str());
+                emit_assertion(record->record_prefix, hit, cond, make_details());
             }
         }
     };
 
+    // Used by ANTITHESIS_ASSERT_DETAILS
+    inline auto make_details() {
+        return []() { return JSON{}; };
+    }
+
+    template <typename MakeDetails>
+    inline MakeDetails&& make_details(MakeDetails&& make) {
+        return std::forward<MakeDetails>(make);
+    }
+
     enum GuidepostType {
         GUIDEPOST_MAXIMIZE,
         GUIDEPOST_MINIMIZE,
@@ -600,169 +2957,294 @@ namespace antithesis::internal::assertions {
         }
     }
 
+    // Renders the part of a guidance record that is fixed for a given guidepost:
+    // everything except `guidance_data` and `hit`, and without the closing braces.
+    template <typename Writer>
+    constexpr void render_guidance_prefix(Writer& writer, GuidepostType type, const char* message, const LocationInfo& location) {
+        writer.raw("{\"antithesis_guidance\":{\"guidance_type\":");
+        writer.string(get_guidance_type_string(type));
+        writer.raw(",\"message\":");
+        writer.string(message);
+        writer.raw(",\"id\":");
+        writer.string(message);
+        writer.raw(",\"location\":");
+        location.render(writer);
+        writer.raw(does_guidance_maximize(type) ? ",\"maximize\":true" : ",\"maximize\":false");
+    }
+
+    // Completes a guidance record started by `render_guidance_prefix`.
+    // Without `guidance_data` this is the catalog record for the guidepost.
+    inline void render_guidance(std::string& buffer, std::string_view record_prefix, const JSON* guidance_data) {
+        JSONWriter writer(buffer);
+        writer.raw(record_prefix);
+        if (guidance_data != nullptr) {
+            writer.raw(",\"guidance_data\":");
+            writer.object(*guidance_data);
+            writer.raw(",\"hit\":true}}");
+        } else {
+            writer.raw(",\"hit\":false}}");
+        }
+    }
+
+    // The CBOR counterpart of `render_guidance`
+    inline void output_guidance(const LocalHandler& output, std::string& buffer, std::string_view record_prefix, const JSON* guidance_data) {
+        using namespace antithesis::internal::cbor;
+        if (guidance_data != nullptr) {
+            CBORWriter(buffer).isolated_object(*guidance_data);
+            const std::array<Member, 2> members{{ { GUIDANCE_DATA_KEY, buffer }, { HIT_KEY, encoded_bool(true) } }};
+            output.output_site_record(record_prefix, members.data(), members.size());
+        } else {
+            const Member hit{ HIT_KEY, encoded_bool(false) };
+            output.output_site_record(record_prefix, &hit, 1);
+        }
+    }
+
+    inline void emit_guidance(std::string_view record_prefix, const JSON* guidance_data) {
+        SelectedHandler& handler = get_lib_handler();
+        std::string& buffer = get_thread_buffer();
+        if (const LocalHandler* cbor_output = LocalHandler::cbor_output()) {
+            output_guidance(*cbor_output, buffer, record_prefix, guidance_data);
+            return;
+        }
+        render_guidance(buffer, record_prefix, guidance_data);
+        handler.output(buffer.data(), buffer.size());
+    }
+
+    // Formats a compared value the way JSONValue would, so guidance data matches the assertion details.
+    template <typename Writer, typename NumericValue>
+    inline void write_numeric_value(Writer& writer, NumericValue value) {
+        if constexpr (std::is_same_v<NumericValue, char> || std::is_same_v<NumericValue, bool>) {
+            writer.value(JSONValue(value));
+        } else {
+            writer.number(value);
+        }
+    }
+
+    // Outputs a numeric guidance record, formatting `left` and `right` straight into the record.
+    template <typename NumericValue>
+    inline void emit_numeric_guidance(std::string_view record_prefix, NumericValue left, NumericValue right) {
+        SelectedHandler& handler = get_lib_handler();
+        std::string& buffer = get_thread_buffer();
+        if (const LocalHandler* cbor_output = LocalHandler::cbor_output()) {
+            using namespace antithesis::internal::cbor;
+            CBORWriter writer(buffer);
+            writer.isolate();
+            write_head(buffer, MAP, 2);
+            writer.string("left");
+            write_numeric_value(writer, left);
+            writer.string("right");
+            write_numeric_value(writer, right);
+            const std::array<Member, 2> members{{ { GUIDANCE_DATA_KEY, buffer }, { HIT_KEY, encoded_bool(true) } }};
+            cbor_output->output_site_record(record_prefix, members.data(), members.size());
+            return;
+        }
+        JSONWriter writer(buffer);
+        writer.raw(record_prefix);
+        writer.raw(",\"guidance_data\":{\"left\":");
+        write_numeric_value(writer, left);
+        writer.raw(",\"right\":");
+        write_numeric_value(writer, right);
+        writer.raw("},\"hit\":true}}");
+        handler.output(buffer.data(), buffer.size());
+    }
+
     template <typename NumericValue, class Value=std::pair<NumericValue, NumericValue>>
     struct NumericGuidepost {
-        const char* message;
-        LocationInfo location;
+        const CatalogRecord* record;
         GuidepostType type;
-        // an approximation of (left - right) / 2; contains an absolute value and a sign bit
-        std::pair<NumericValue, bool> extreme_half_gap;
-
-        NumericGuidepost(const char* message, LocationInfo&& location, GuidepostType type) :
-            message(message), location(std::move(location)), type(type) {
-                this->add_to_catalog();
-                if (type == GUIDEPOST_MAXIMIZE) {
-                    extreme_half_gap = { std::numeric_limits<NumericValue>::max(), false }; 
-                } else {
-                    extreme_half_gap = { std::numeric_limits<NumericValue>::max(), true };
-                }
-            }
-
-        inline void add_to_catalog() {
-            std::string id = make_key(message, location);
-            JSON catalog{
-                {"antithesis_guidance", JSON{
-                    {"guidance_type", get_guidance_type_string(type)},
-                    {"message", message},
-                    {"id", id},
-                    {"location", location.to_json()},
-                    {"maximize", does_guidance_maximize(type)},
-                    {"hit", false}
-                }}
-            };
-            get_lib_handler().output(catalog);
-        }
-
-        std::pair<NumericValue, bool> compute_half_gap(NumericValue left, NumericValue right) {
-            // An extremely baroque way to compute (left - right) / 2, rounded toward 0, without overflowing or underflowing
-            if (std::is_integral_v<NumericValue>) {
-                // If both numbers are odd then the gap doesn't change if we subtract 1 from both sides
-                // Also subtracting 1 from both sides won't underflow
-                if (left % 2 == 1 && right % 2 == 1) 
-                    return compute_half_gap( left - 1, right - 1);
-                // If one number is odd then we subtract 1 from the larger number
-                // This rounds the computation toward 0 but again won't underflow
-                if (left % 2 == 1 || right % 2 == 1) {
-                    if (left > right) {
-                        return compute_half_gap( left - 1, right );
-                    } else {
-                        return compute_half_gap( left, right - 1 );
-                    }
-                }
-                // At this point both numbers are even, so the midpoint calculation is exact
-                NumericValue half_left = left / 2;
-                NumericValue half_right = right / 2;
-                NumericValue midpoint = half_left + half_right;
-                // This won't overflow or underflow because we're subtracting the midpoint
-                // We compute a positive value and a sign so that we don't have to do weird things with unsigned types
-                if (left > right) {
-                    return { midpoint - right, true };
-                } else {
-                    return { right - midpoint, false };
-                }
+        // The best half gap sent so far by any thread, as packed by `pack_half_gap`; 0 before the first
+        std::atomic<uint64_t> extreme;
+
+        constexpr NumericGuidepost(const CatalogRecord* record, GuidepostType type) :
+            record(record), type(type), extreme(0) {}
+
+        // Computes (left - right) / 2, rounded toward 0, as an absolute value and a sign bit, without
+        // overflowing for any pair of inputs. Both sides are selected rather than branched on.
+        static constexpr std::pair<NumericValue, bool> compute_half_gap(NumericValue left, NumericValue right) {
+            const bool positive = left > right;
+            const NumericValue high = positive ? left : right;
+            const NumericValue low = positive ? right : left;
+            if constexpr (std::is_same_v<NumericValue, bool>) {
+                // Half of a gap of at most 1 rounds to 0, leaving only the sign
+                return { false, positive };
+            } else if constexpr (std::is_integral_v<NumericValue>) {
+                // The distance between any two values fits the unsigned type, where subtraction wraps exactly,
+                // and half of it fits back into the original type
+                using Unsigned = std::make_unsigned_t<NumericValue>;
+                const Unsigned gap = static_cast<Unsigned>(static_cast<Unsigned>(high) - static_cast<Unsigned>(low));
+                return { static_cast<NumericValue>(gap / 2), positive };
             } else {
-                // If it's floating point we don't need to worry about overflowing, just do the arithmetic
-                return { left > right ? (left - right) / 2 : (right - left) / 2, left > right };
+                // Halving first keeps the difference of two large values of opposite sign finite. Equal
+                // infinities are a gap of 0 rather than NaN.
+                return { high == low ? NumericValue(0) : high / 2 - low / 2, positive };
             }
         }
 
-        bool should_send_value(std::pair<NumericValue, bool> half_gap) {
-            if (this->type == GUIDEPOST_MAXIMIZE) {
-                if (half_gap.second && !extreme_half_gap.second) {
-                    // we're positive and the extreme value isn't; always send back
-                    return true;
-                } else if (!half_gap.second && extreme_half_gap.second) {
-                    // we're negative and the extreme value is positive; never send back
-                    return false;
-                } else if (half_gap.second && extreme_half_gap.second) {
-                    // both positive; send back if our absolute value is at least as large
-                    return half_gap.first >= extreme_half_gap.first;
-                } else {
-                    // both negative; send back if our absolute value is at least as small
-                    return half_gap.first <= extreme_half_gap.first;
-                }
+        // Packs a half gap into an integer that grows as the half gap gets better for this guidepost, so
+        // extremes are compared and merged as plain integers. Positive half gaps order above negative ones,
+        // and within each sign by magnitude. The result is 0 only for a NaN half gap, which is then never sent
+        // since it is no better than the initial extreme; the single worst value shares 1 with the next.
+        uint64_t pack_half_gap(std::pair<NumericValue, bool> half_gap) const {
+            constexpr uint64_t SIGN = uint64_t(1) << 63;
+            uint64_t magnitude;
+            if constexpr (std::is_integral_v<NumericValue>) {
+                magnitude = static_cast<uint64_t>(half_gap.first);
             } else {
-                if (half_gap.second && !extreme_half_gap.second) {
-                    // we're positive and the extreme value isn't; never send back
-                    return false;
-                } else if (!half_gap.second && extreme_half_gap.second) {
-                    // we're negative and the extreme value is positive; always send back
-                    return true;
-                } else if (half_gap.second && extreme_half_gap.second) {
-                    // both positive; send back if our absolute value is at least as small
-                    return half_gap.first <= extreme_half_gap.first;
-                } else {
-                    // both negative; send back if our absolute value is at least as large
-                    return half_gap.first >= extreme_half_gap.first;
+                if (half_gap.first != half_gap.first) {
+                    return 0;
                 }
+                // The bits of a non-negative double order the same way as its value
+                magnitude = std::bit_cast<uint64_t>(static_cast<double>(half_gap.first)) & ~SIGN;
             }
+            const uint64_t ordered = half_gap.second ? (SIGN | magnitude) : ((SIGN - 1) - magnitude);
+            const uint64_t packed = type == GUIDEPOST_MAXIMIZE ? ordered : ~ordered;
+            return packed == 0 ? 1 : packed;
         }
 
-        [[clang::always_inline]] inline void send_guidance(Value value) {
-            std::pair<NumericValue, bool> half_gap = compute_half_gap(value.first, value.second);
-            if (should_send_value(half_gap)) {
-                extreme_half_gap = half_gap;
-                std::string id = make_key(this->message, this->location);
-                JSON guidance{
-                    {"antithesis_guidance", JSON{
-                        {"guidance_type", get_guidance_type_string(this->type)},
-                        {"message", this->message},
-                        {"id", id},
-                        {"location", this->location.to_json()},
-                        {"maximize", does_guidance_maximize(this->type)},
-                        {"guidance_data", JSON{ 
-                            { "left", value.first },    
-                            { "right", value.second } }},
-                        {"hit", true}
-                    }}
-                };
-                get_lib_handler().output(guidance);
+        // Sends `value` if it is a new extreme across all threads; each new extreme is sent exactly once.
+        // Every thread keeps the best half gap it knows of in `thread_extreme`, so a value that is no
+        // improvement touches no shared memory. Improvements are merged into `extreme` by compare-and-swap,
+        // and only the thread that installs a new extreme sends it.
+        [[clang::always_inline]] inline void send_guidance(uint64_t& thread_extreme, Value value) {
+            const uint64_t packed = pack_half_gap(compute_half_gap(value.first, value.second));
+            if (__builtin_expect(packed > thread_extreme, false)) {
+                merge_extreme(thread_extreme, packed, value);
             }
+        }
+
+        [[clang::noinline]] void merge_extreme(uint64_t& thread_extreme, uint64_t packed, Value value) {
+            uint64_t current = extreme.load(std::memory_order_relaxed);
+            do {
+                if (packed <= current) {
+                    // Another thread already got here; catch up with it
+                    thread_extreme = current;
+                    return;
+                }
+            } while (!extreme.compare_exchange_weak(current, packed, std::memory_order_relaxed));
+            thread_extreme = packed;
+            emit_numeric_guidance(this->record->record_prefix, value.first, value.second);
         }   
     };
 
     template <typename GuidanceType>
     struct BooleanGuidepost {
-        const char* message;
-        LocationInfo location;
+        const CatalogRecord* record;
         GuidepostType type;
 
-        BooleanGuidepost(const char* message, LocationInfo&& location, GuidepostType type) :
-            message(message), location(std::move(location)), type(type) {
-                this->add_to_catalog();
-            }
-
-        inline void add_to_catalog() {
-            std::string id = make_key(message, location);
-            JSON catalog{
-                {"antithesis_guidance", JSON{
-                    {"guidance_type", get_guidance_type_string(type)},
-                    {"message", message},
-                    {"id", id},
-                    {"location", location.to_json()},
-                    {"maximize", does_guidance_maximize(type)},
-                    {"hit", false}
-                }}
-            };
-            get_lib_handler().output(catalog);
-        }
+        constexpr BooleanGuidepost(const CatalogRecord* record, GuidepostType type) :
+            record(record), type(type) {}
 
         inline virtual void send_guidance(GuidanceType data) {
-            std::string id = make_key(this->message, this->location);
-            JSON guidance{
-                {"antithesis_guidance", JSON{
-                    {"guidance_type", get_guidance_type_string(this->type)},
-                    {"message", this->message},
-                    {"id", id},
-                    {"location", location.to_json()},
-                    {"maximize", does_guidance_maximize(this->type)},
-                    {"guidance_data", data},
-                    {"hit", true}
-                }}
-            };
-            get_lib_handler().output(guidance);
+            emit_guidance(this->record->record_prefix, &data);
         }
     };
+
+    // The catalog records of one module. Every translation unit registers its module's section during static
+    // initialization; the first registration in the process initializes the handler, which emits the catalog.
+    struct CatalogSection {
+        const CatalogRecord* start;
+        const CatalogRecord* stop;
+        // The module's assertion sites, so that a forked child starting its own output can report first hits again
+        Assertion* assertions_start;
+        Assertion* assertions_stop;
+        CatalogSection* next;
+    };
+
+    // Process-wide list of registered sections, and whether the catalog has been emitted yet
+    inline CatalogSection* catalog_sections = nullptr;
+    inline bool catalog_emitted = false;
+
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+    // Emits the catalog records of a section that have not been emitted before, and flushes once.
+    inline void emit_catalog_section(LibHandler& handler, const CatalogSection& section) {
+        CatalogEntryTracker& tracker = get_catalog_entry_tracker();
+        for (const CatalogRecord* record = section.start; record != section.stop; record++) {
+            if (!tracker.insert(record->key)) {
+                continue;
+            }
+            std::string& buffer = get_thread_buffer();
+            if (const LocalHandler* cbor_output = LocalHandler::cbor_output()) {
+                if (record->kind == CatalogRecord::ASSERTION_RECORD) {
+                    output_assertion(*cbor_output, buffer, record->record_prefix, false, record->catalog_condition, JSON{});
+                } else {
+                    output_guidance(*cbor_output, buffer, record->record_prefix, nullptr);
+                }
+                continue;
+            }
+            if (record->kind == CatalogRecord::ASSERTION_RECORD) {
+                render_assertion(buffer, record->record_prefix, false, record->catalog_condition, JSON{});
+            } else {
+                render_guidance(buffer, record->record_prefix, nullptr);
+            }
+            handler.output_unflushed(buffer.data(), buffer.size());
+        }
+        handler.flush();
+    }
+    #pragma clang diagnostic pop
+
+    inline void register_catalog_section(CatalogSection& section) {
+        if (section.start == section.stop) {
+            return;
+        }
+        for (CatalogSection* registered = catalog_sections; registered != nullptr; registered = registered->next) {
+            if (registered->start == section.start) {
+                return;
+            }
+        }
+        section.next = catalog_sections;
+        catalog_sections = &section;
+
+        if (!catalog_emitted) {
+            // Initializing the handler emits the catalog of every registered section. That waits for the first
+            // record, or for set_handler, so that a handler registered in main still gets the catalog; a process
+            // that emits nothing at all initializes the handler as it exits.
+            static const bool initialize_at_exit = [] {
+                atexit([] { get_lib_handler(); });
+                return true;
+            }();
+            (void)initialize_at_exit;
+        } else {
+            // A module loaded after the handler was initialized
+            emit_catalog_section(get_lib_handler(), section);
+        }
+    }
+}
+
+namespace antithesis::internal::handlers {
+    inline void emit_catalog(LibHandler& handler) {
+        using namespace antithesis::internal::assertions;
+        catalog_emitted = true;
+        for (CatalogSection* section = catalog_sections; section != nullptr; section = section->next) {
+            emit_catalog_section(handler, *section);
+        }
+    }
+
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+    // Runs in a forked child that writes to an output of its own, in which nothing has been reported yet.
+    inline void start_child_output(LibHandler& handler) {
+        using namespace antithesis::internal::assertions;
+        for (CatalogSection* section = catalog_sections; section != nullptr; section = section->next) {
+            for (Assertion* assertion = section->assertions_start; assertion != section->assertions_stop; assertion++) {
+                assertion->state.reset();
+            }
+        }
+        get_catalog_entry_tracker().clear();
+        emit_version_record(handler);
+        emit_catalog(handler);
+    }
+    #pragma clang diagnostic pop
+}
+
+// Bounds of this module's `antithesis_catalog` and `antithesis_assertions` sections, defined by the linker. They
+// are hidden so that each executable or shared library finds its own records, and weak so that a module without
+// records links.
+extern "C" {
+    extern const antithesis::internal::assertions::CatalogRecord __start_antithesis_catalog[] __attribute__((weak, visibility("hidden")));
+    extern const antithesis::internal::assertions::CatalogRecord __stop_antithesis_catalog[] __attribute__((weak, visibility("hidden")));
+    extern antithesis::internal::assertions::Assertion __start_antithesis_assertions[] __attribute__((weak, visibility("hidden")));
+    extern antithesis::internal::assertions::Assertion __stop_antithesis_assertions[] __attribute__((weak, visibility("hidden")));
 }
 
 namespace antithesis::internal {
@@ -789,7 +3271,7 @@ namespace { // Anonymous namespace which is translation-unit-specific; certain s
         }
         #pragma clang diagnostic pop
 
-        const char* c_str() const { return contents.data(); }
+        constexpr const char* c_str() const { return contents.data(); }
     };
 
     template <std::size_t N>
@@ -805,46 +3287,80 @@ namespace { // Anonymous namespace which is translation-unit-specific; certain s
     #pragma clang diagnostic pop
 
     template <antithesis::internal::assertions::AssertionType type, fixed_string message, fixed_string file_name, fixed_string function_name, int line, int column>
-    struct CatalogEntry {
-        [[clang::always_inline]] static inline antithesis::internal::assertions::Assertion create() {
+    struct AssertionRecord {
+        static constexpr void render(auto& writer) {
             antithesis::internal::assertions::LocationInfo location{ "", function_name.c_str(), file_name.c_str(), line, column };
-            return antithesis::internal::assertions::Assertion(message.c_str(), type, std::move(location));
+            antithesis::internal::assertions::render_assertion_prefix(writer, type, message.c_str(), location);
         }
+    };
+
+    template <antithesis::internal::assertions::GuidepostType type, fixed_string message, fixed_string file_name, fixed_string function_name, int line, int column>
+    struct GuidanceRecord {
+        static constexpr void render(auto& writer) {
+            antithesis::internal::assertions::LocationInfo location{ "", function_name.c_str(), file_name.c_str(), line, column };
+            antithesis::internal::assertions::render_guidance_prefix(writer, type, message.c_str(), location);
+        }
+    };
+
+    #define ANTITHESIS_CATALOG_RECORD __attribute__((used, retain, section("antithesis_catalog")))
+
+    template <antithesis::internal::assertions::AssertionType type, fixed_string message, fixed_string file_name, fixed_string function_name, int line, int column>
+    struct CatalogEntry {
+        static constexpr auto record_prefix = antithesis::internal::json::prerender<AssertionRecord<type, message, file_name, function_name, line, column>>();
+
+        ANTITHESIS_CATALOG_RECORD static inline constinit const antithesis::internal::assertions::CatalogRecord catalog_record{
+            antithesis::internal::assertions::CatalogRecord::ASSERTION_RECORD,
+            type == antithesis::internal::assertions::REACHABLE_ASSERTION,
+            antithesis::internal::assertions::make_key(message.c_str()),
+            std::string_view(record_prefix.data(), record_prefix.size())
+        };
 
-        static inline antithesis::internal::assertions::Assertion assertion = create();
+        __attribute__((used, retain, section("antithesis_assertions"))) static inline constinit antithesis::internal::assertions::Assertion assertion{ &catalog_record };
     };
 
     template<typename GuidanceDataType, antithesis::internal::assertions::GuidepostType type, fixed_string message, fixed_string file_name, fixed_string function_name, int line, int column>
     struct BooleanGuidanceCatalogEntry {
-        [[clang::always_inline]] static inline antithesis::internal::assertions::BooleanGuidepost<GuidanceDataType> create() {
-            antithesis::internal::assertions::LocationInfo location{ "", function_name.c_str(), file_name.c_str(), line, column };
-            switch (type) {
-                case antithesis::internal::assertions::GUIDEPOST_ALL:
-                case antithesis::internal::assertions::GUIDEPOST_NONE:
-                    return antithesis::internal::assertions::BooleanGuidepost<GuidanceDataType>(message.c_str(), std::move(location), type);
-                default:
-                    throw std::runtime_error("Can't create boolean guidepost with non-boolean type");
-            }
-        }
-        
-        static inline antithesis::internal::assertions::BooleanGuidepost<GuidanceDataType> guidepost = create();
+        static_assert(type == antithesis::internal::assertions::GUIDEPOST_ALL || type == antithesis::internal::assertions::GUIDEPOST_NONE,
+            "Can't create boolean guidepost with non-boolean type");
+
+        static constexpr auto record_prefix = antithesis::internal::json::prerender<GuidanceRecord<type, message, file_name, function_name, line, column>>();
+
+        ANTITHESIS_CATALOG_RECORD static inline constinit const antithesis::internal::assertions::CatalogRecord catalog_record{
+            antithesis::internal::assertions::CatalogRecord::GUIDANCE_RECORD,
+            false,
+            antithesis::internal::assertions::make_key(std::string_view(record_prefix.data(), record_prefix.size())),
+            std::string_view(record_prefix.data(), record_prefix.size())
+        };
+
+        static inline constinit antithesis::internal::assertions::BooleanGuidepost<GuidanceDataType> guidepost{ &catalog_record, type };
     };
 
     template<typename NumericType, antithesis::internal::assertions::GuidepostType type, fixed_string message, fixed_string file_name, fixed_string function_name, int line, int column>
     struct NumericGuidanceCatalogEntry {
-        [[clang::always_inline]] static inline antithesis::internal::assertions::NumericGuidepost<NumericType> create() {
-            antithesis::internal::assertions::LocationInfo location{ "", function_name.c_str(), file_name.c_str(), line, column };
-            switch (type) {
-                case antithesis::internal::assertions::GUIDEPOST_MAXIMIZE:
-                case antithesis::internal::assertions::GUIDEPOST_MINIMIZE:
-                    return antithesis::internal::assertions::NumericGuidepost<NumericType>(message.c_str(), std::move(location), type);
-                default:
-                    throw std::runtime_error("Can't create numeric guidepost with non-numeric type");
-            }
-        }
-        
-        static inline antithesis::internal::assertions::NumericGuidepost<NumericType> guidepost = create();
+        static_assert(type == antithesis::internal::assertions::GUIDEPOST_MAXIMIZE || type == antithesis::internal::assertions::GUIDEPOST_MINIMIZE,
+            "Can't create numeric guidepost with non-numeric type");
+
+        static constexpr auto record_prefix = antithesis::internal::json::prerender<GuidanceRecord<type, message, file_name, function_name, line, column>>();
+
+        ANTITHESIS_CATALOG_RECORD static inline constinit const antithesis::internal::assertions::CatalogRecord catalog_record{
+            antithesis::internal::assertions::CatalogRecord::GUIDANCE_RECORD,
+            false,
+            antithesis::internal::assertions::make_key(std::string_view(record_prefix.data(), record_prefix.size())),
+            std::string_view(record_prefix.data(), record_prefix.size())
+        };
+
+        static inline constinit antithesis::internal::assertions::NumericGuidepost<std::remove_cvref_t<NumericType>> guidepost{ &catalog_record, type };
+        // This thread's view of `guidepost.extreme`
+        static inline thread_local constinit uint64_t thread_extreme = 0;
     };
+
+    #undef ANTITHESIS_CATALOG_RECORD
+
+    // One per translation unit; all of them in a module register the same section, which is deduplicated
+    antithesis::internal::assertions::CatalogSection catalog_section{
+        __start_antithesis_catalog, __stop_antithesis_catalog, __start_antithesis_assertions, __stop_antithesis_assertions, nullptr };
+
+    [[maybe_unused]] const bool catalog_section_registered = (antithesis::internal::assertions::register_catalog_section(catalog_section), true);
 }
 }
 
@@ -915,13 +3431,13 @@ namespace { // Anonymous namespace which is translation-unit-specific; certain s
     ANTITHESIS_SDK_SOMETIMES_POLYFILL((val <= threshold), message, __VA_ARGS__)
 #define ALWAYS_SOME(pairs, message, ...) \
     ANTITHESIS_SDK_ALWAYS_POLYFILL(([]( \
-        std::initializer_list<std::pair<std::string, bool>> ps){ \
+        std::initializer_list<std::pair<std::string_view, bool>> ps){ \
     for (auto const& pair : ps) \
         if (pair.second) return true; \
     return false; }(pairs)), message, __VA_ARGS__)
 #define SOMETIMES_ALL(pairs, message, ...) \
     ANTITHESIS_SDK_SOMETIMES_POLYFILL(([]( \
-        std::initializer_list<std::pair<std::string, bool>> ps){ \
+        std::initializer_list<std::pair<std::string_view, bool>> ps){ \
     for (auto const& pair : ps) \
         if (!pair.second) return false; \
     return true; }(pairs)), message, __VA_ARGS__)
@@ -932,6 +3448,14 @@ namespace { // Anonymous namespace which is translation-unit-specific; certain s
 
 #define FIXED_STRING_FROM_C_STR(s) (antithesis::internal::fixed_string<antithesis::internal::string_length(s)+1>::from_c_str(s))
 
+// Details are passed to check_assertion as a lambda, so they are only built when a record is emitted. An assertion
+// without details gets a lambda without captures, which can be used anywhere, including in namespace-scope
+// initializers. Details that refer to anything are captured by reference, which a lambda can only do in a function
+// body or a default member initializer; at namespace scope, make the assertion from an immediately invoked lambda.
+// Details there used to compile, when they were built eagerly; the README notes this break.
+#define ANTITHESIS_ASSERT_DETAILS(...) \
+    antithesis::internal::assertions::make_details(__VA_OPT__([&]() { return antithesis::JSON(__VA_ARGS__); }))
+
 #define ANTITHESIS_ASSERT_RAW(type, cond, message, ...) ( \
     antithesis::internal::CatalogEntry< \
         type, \
@@ -940,7 +3464,7 @@ namespace { // Anonymous namespace which is translation-unit-specific; certain s
         FIXED_STRING_FROM_C_STR(std::source_location::current().function_name()), \
         std::source_location::current().line(), \
         std::source_location::current().column() \
-    >::assertion.check_assertion(cond, (antithesis::JSON(__VA_ARGS__)) ) )
+    >::assertion.check_assertion(cond, ANTITHESIS_ASSERT_DETAILS(__VA_ARGS__)) )
 
 #define ALWAYS(cond, message, ...) ANTITHESIS_ASSERT_RAW(antithesis::internal::assertions::ALWAYS_ASSERTION, cond, message, __VA_ARGS__)
 #define ALWAYS_OR_UNREACHABLE(cond, message, ...) ANTITHESIS_ASSERT_RAW(antithesis::internal::assertions::ALWAYS_OR_UNREACHABLE_ASSERTION, cond, message, __VA_ARGS__)
@@ -952,7 +3476,7 @@ namespace { // Anonymous namespace which is translation-unit-specific; certain s
 do { \
     static_assert(std::is_same_v<decltype(left), decltype(right)>, "Values compared in " #name " must be of same type"); \
     ANTITHESIS_ASSERT_RAW(assertion_type, left cmp right, message, __VA_ARGS__ __VA_OPT__(,) {{ "left", left }, { "right", right }} ); \
-    antithesis::internal::NumericGuidanceCatalogEntry< \
+    using antithesis_guidance_entry = antithesis::internal::NumericGuidanceCatalogEntry< \
         decltype(left), \
         guidepost_type, \
         antithesis::internal::fixed_string(message), \
@@ -960,7 +3484,8 @@ do { \
         FIXED_STRING_FROM_C_STR(std::source_location::current().function_name()), \
         std::source_location::current().line(), \
         std::source_location::current().column() \
-    >::guidepost.send_guidance({ left, right }); \
+    >; \
+    antithesis_guidance_entry::guidepost.send_guidance(antithesis_guidance_entry::thread_extreme, { left, right }); \
 } while (0)
 
 #define ALWAYS_GREATER_THAN(left, right, message, ...) \
@@ -983,7 +3508,7 @@ ANTITHESIS_NUMERIC_ASSERT_RAW(SOMETIMES_LESS_THAN_OR_EQUAL_TO, antithesis::inter
 #define ALWAYS_SOME(pairs, message, ...) \
 do { \
     ANTITHESIS_ASSERT_RAW(antithesis::internal::assertions::ALWAYS_ASSERTION, ( \
-        [](std::initializer_list<std::pair<std::string, bool>> ps){ \
+        [](std::initializer_list<std::pair<std::string_view, bool>> ps){ \
             for (auto const& pair : ps) \
                 if (pair.second) return true; \
             return false; }(pairs)), \
@@ -1002,7 +3527,7 @@ do { \
 #define SOMETIMES_ALL(pairs, message, ...) \
 do { \
     ANTITHESIS_ASSERT_RAW(antithesis::internal::assertions::SOMETIMES_ASSERTION, ( \
-        [](std::initializer_list<std::pair<std::string, bool>> ps){ \
+        [](std::initializer_list<std::pair<std::string_view, bool>> ps){ \
             for (auto const& pair : ps) \
                 if (!pair.second) return false; \
             return true; }(pairs)), \
@@ -1020,6 +3545,49 @@ do { \
 
 #endif
 
+/*****************************************************************************
+ * PUBLIC SDK: HANDLERS
+ *****************************************************************************/
+
+#include <memory>
+
+#ifdef NO_ANTITHESIS_SDK
+
+namespace antithesis {
+    inline bool set_handler(std::unique_ptr<Handler>) {
+        return false;
+    }
+}
+
+#else
+
+namespace antithesis {
+    // Sends every record to `handler` and takes random values from it, instead of the Antithesis runtime or
+    // local output. The SDK chooses its handler once, when it emits its first record, so this has to be called
+    // before that; it returns false, and drops `handler`, if it is too late or a handler is bound at compile
+    // time. The SDK initializes with `handler` right away, which emits the version record and the catalog of
+    // the program's assertions to it.
+    inline bool set_handler(std::unique_ptr<Handler> handler) {
+#ifdef ANTITHESIS_SDK_HANDLER
+        return false;
+#else
+        using namespace antithesis::internal::handlers;
+        {
+            std::lock_guard<std::mutex> lock(registered_handler_mutex);
+            if (handler_taken) {
+                return false;
+            }
+            delete registered_handler;
+            registered_handler = handler.release();
+        }
+        get_lib_handler();
+        return true;
+#endif
+    }
+}
+
+#endif
+
 /*****************************************************************************
  * PUBLIC SDK: LIFECYCLE
  *****************************************************************************/
@@ -1027,10 +3595,13 @@ do { \
 #ifdef NO_ANTITHESIS_SDK
 
 namespace antithesis {
-    inline void setup_complete(const JSON& details) {
+    inline void setup_complete(const JSON&) {
     }
 
-    inline void send_event(const char* name, const JSON& details) {
+    inline void send_event(const char*, const JSON&) {
+    }
+
+    inline void flush() {
     }
 }
 
@@ -1044,12 +3615,21 @@ namespace antithesis {
                 {"details", details}
             }} 
         };
-        antithesis::internal::handlers::get_lib_handler().output(json);
+        antithesis::internal::handlers::SelectedHandler& handler = antithesis::internal::handlers::get_lib_handler();
+        antithesis::internal::handlers::output_json(handler, json);
+        handler.flush();
     }
 
     inline void send_event(const char* name, const JSON& details) {
         JSON json = { { name, details } };
-        antithesis::internal::handlers::get_lib_handler().output(json);
+        antithesis::internal::handlers::SelectedHandler& handler = antithesis::internal::handlers::get_lib_handler();
+        antithesis::internal::handlers::output_json(handler, json);
+        handler.flush();
+    }
+
+    // Makes all records emitted so far visible to Antithesis, when records are being coalesced.
+    inline void flush() {
+        antithesis::internal::handlers::get_lib_handler().flush();
     }
 }
 #endif
@@ -1058,18 +3638,33 @@ namespace antithesis {
  * PUBLIC SDK: RANDOM
  *****************************************************************************/
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+
 namespace antithesis {
     // Declarations that we expose
     uint64_t get_random();
+#if defined(__cpp_lib_span)
+    void fill_random(std::span<uint64_t> words);
+#endif
 }
 
 #ifdef NO_ANTITHESIS_SDK
 
 namespace antithesis {
     inline uint64_t get_random() {
-        static antithesis::internal::random::LocalRandom random_gen;
-        return random_gen.random();
+        return antithesis::internal::random::local_random();
     }
+
+#if defined(__cpp_lib_span)
+    inline void fill_random(std::span<uint64_t> words) {
+        for (uint64_t& word : words) {
+            word = antithesis::internal::random::local_random();
+        }
+    }
+#endif
 }
 
 #else
@@ -1078,11 +3673,55 @@ namespace antithesis {
     inline uint64_t get_random() {
         return antithesis::internal::handlers::get_lib_handler().random();
     }
+
+#if defined(__cpp_lib_span)
+    // Fills `words` with random values, fetching all of them in one call to the handler.
+    inline void fill_random(std::span<uint64_t> words) {
+        antithesis::internal::handlers::get_lib_handler().random_fill(words.data(), words.size());
+    }
+#endif
 }
 
 #endif
 
 namespace antithesis {
+#if defined(__cpp_lib_span)
+    // Fills `bytes` with random bytes, fetching them a batch of words at a time.
+    inline void fill_random_bytes(std::span<std::byte> bytes) {
+        std::array<uint64_t, 32> words;
+        while (!bytes.empty()) {
+            const size_t count = std::min(words.size(), (bytes.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+            fill_random(std::span<uint64_t>(words.data(), count));
+            const size_t length = std::min(bytes.size(), count * sizeof(uint64_t));
+            memcpy(bytes.data(), words.data(), length);
+            bytes = bytes.subspan(length);
+        }
+    }
+#endif
+
+    // Returns a uniformly distributed integer in [lo, hi], both inclusive; `lo` must not exceed `hi`.
+    // Uses Lemire's multiply-shift reduction, which needs no division in the common case and rejects
+    // just enough values to be unbiased.
+    template <typename Integer, typename std::enable_if<std::is_integral<Integer>::value && !std::is_same<Integer, bool>::value, bool>::type = true>
+    Integer get_random_range(Integer lo, Integer hi) {
+        typedef std::make_unsigned_t<Integer> Unsigned;
+        // The number of values in range; 0 when that is every 64-bit value
+        const uint64_t width = static_cast<uint64_t>(static_cast<Unsigned>(static_cast<Unsigned>(hi) - static_cast<Unsigned>(lo))) + 1;
+        uint64_t random = get_random();
+        if (width == 0) {
+            return static_cast<Integer>(random);
+        }
+        antithesis::internal::random::Product128 product = antithesis::internal::random::multiply_128(random, width);
+        if (product.low < width) {
+            const uint64_t threshold = -width % width;
+            while (product.low < threshold) {
+                random = get_random();
+                product = antithesis::internal::random::multiply_128(random, width);
+            }
+        }
+        return static_cast<Integer>(static_cast<Unsigned>(static_cast<Unsigned>(lo) + static_cast<Unsigned>(product.high)));
+    }
+
     template <typename Iter>
     Iter random_choice(Iter begin, Iter end) {
         ssize_t num_things = end - begin;
@@ -1090,8 +3729,7 @@ namespace antithesis {
             return end;
         }
 
-        uint64_t uval = get_random();
-        ssize_t index = uval % num_things;
+        ssize_t index = get_random_range<ssize_t>(0, num_things - 1);
         return begin + index;
     }
 }
@@ -0,0 +1,133 @@
+#pragma once
+
+// Minimal harness for the SDK micro-benchmarks. Each benchmark runs a loop body a fixed number of times and
+// reports the time per iteration and, where the kernel allows it, the instructions retired per iteration.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace bench {
+    // Keeps the compiler from discarding a value or hoisting its computation out of the loop.
+    template <typename T>
+    inline void do_not_optimize(const T& value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // Counts user-space instructions retired by this thread, if perf events are available.
+    class InstructionCounter {
+    public:
+        InstructionCounter() {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+
+        ~InstructionCounter() {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+
+        bool available() const { return fd >= 0; }
+
+        void start() {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        uint64_t stop() {
+            uint64_t count = 0;
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                    count = 0;
+                }
+            }
+            return count;
+        }
+
+    private:
+        int fd;
+    };
+
+    // Runs `body(i)` for `iterations` values of i, split evenly over `threads` threads that start together, and
+    // prints the wall-clock time per iteration of each thread and the instructions retired per iteration overall.
+    // Each value of i is passed exactly once, so bodies may use it to pick work that must not repeat; in that
+    // case pass `warm_up = false`, since the warm-up reuses the first values of each thread.
+    template <typename Body>
+    void run_threads(const char* name, unsigned threads, uint64_t iterations, Body&& body, bool warm_up = true) {
+        const uint64_t per_thread = iterations / threads;
+        std::atomic<unsigned> ready{0};
+        std::atomic<bool> go{false};
+        std::atomic<uint64_t> instructions{0};
+        std::atomic<bool> counted{true};
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                const uint64_t first = t * per_thread;
+                if (warm_up) {
+                    for (uint64_t i = first; i < first + per_thread / 16; i++) {
+                        body(i);
+                    }
+                }
+
+                InstructionCounter counter;
+                ready.fetch_add(1);
+                while (!go.load()) {
+                    std::this_thread::yield();
+                }
+                counter.start();
+                for (uint64_t i = first; i < first + per_thread; i++) {
+                    body(i);
+                }
+                instructions.fetch_add(counter.stop());
+                if (!counter.available()) {
+                    counted.store(false);
+                }
+            });
+        }
+        while (ready.load() < threads) {
+            std::this_thread::yield();
+        }
+        const auto start = std::chrono::steady_clock::now();
+        go.store(true);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        if (counted.load()) {
+            printf("%-56s %3u threads %10.2f ns/op %10.2f instructions/op\n", name, threads, ns / static_cast<double>(per_thread),
+                static_cast<double>(instructions.load()) / static_cast<double>(per_thread * threads));
+        } else {
+            printf("%-56s %3u threads %10.2f ns/op\n", name, threads, ns / static_cast<double>(per_thread));
+        }
+    }
+
+    // Runs `body(i)` for `iterations` values of i on a single thread, after a short warm-up.
+    template <typename Body>
+    void run(const char* name, uint64_t iterations, Body&& body) {
+        run_threads(name, 1, iterations, std::forward<Body>(body));
+    }
+}
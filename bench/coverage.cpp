@@ -0,0 +1,91 @@
+// Measures what edge coverage costs a tight loop, with the callbacks of antithesis_instrumentation.h. The
+// workload marks its edges by hand the way clang instruments them, so the comparison builds with any compiler:
+// with -fsanitize-coverage=trace-pc-guard every edge calls __sanitizer_cov_trace_pc_guard, and with
+// inline-8bit-counters,pc-table every edge increments its own byte counter in place.
+//
+// The guard callback does what the environment selects, as in an instrumented program: with
+// ANTITHESIS_SDK_LIB_PATH naming the fake libvoidstar from tools/, it forwards each edge to the library;
+// with ANTITHESIS_SDK_LOCAL_COVERAGE set, it counts each edge locally; otherwise it returns.
+
+#include "bench.h"
+
+#include <cstdint>
+#include <cstdio>
+
+extern "C" {
+    void __sanitizer_cov_trace_pc_guard_init(uint32_t* start, uint32_t* stop);
+    void __sanitizer_cov_trace_pc_guard(uint32_t* guard);
+    void __sanitizer_cov_8bit_counters_init(char* start, char* end);
+    void __sanitizer_cov_pcs_init(const uintptr_t* begin, const uintptr_t* end);
+}
+
+static constexpr uint64_t ITERATIONS = 50'000'000;
+
+enum Instrumentation { NONE, GUARDS, COUNTERS };
+
+static constexpr size_t EDGE_COUNT = 8;
+static uint32_t guards[EDGE_COUNT];
+static uint8_t counters[EDGE_COUNT];
+// One (PC, flags) pair per counter, as the pc-table section holds
+static uintptr_t pcs[EDGE_COUNT * 2];
+
+template <Instrumentation instrumentation>
+[[gnu::always_inline]] inline void edge(size_t id) {
+    if constexpr (instrumentation == GUARDS) {
+        __sanitizer_cov_trace_pc_guard(&guards[id]);
+    } else if constexpr (instrumentation == COUNTERS) {
+        // A plain increment, but one the optimizer may not merge across iterations, which clang's counters
+        // are not merged across either
+        __atomic_store_n(&counters[id], static_cast<uint8_t>(__atomic_load_n(&counters[id], __ATOMIC_RELAXED) + 1), __ATOMIC_RELAXED);
+    }
+}
+
+// Classifies the bytes of `value` in a short loop with a branch per byte: a stand-in for the tight, branchy
+// loops (parsers, state machines) where the per-edge cost of coverage shows most
+template <Instrumentation instrumentation>
+[[gnu::noinline]] uint64_t workload(uint64_t value) {
+    edge<instrumentation>(0);
+    uint64_t state = 0;
+    for (int i = 0; i < 8; i++) {
+        edge<instrumentation>(1);
+        const uint8_t byte = static_cast<uint8_t>(value >> (i * 8));
+        if (byte < 0x30) {
+            edge<instrumentation>(2);
+            state = state * 31 + 1;
+        } else if (byte < 0x80) {
+            edge<instrumentation>(3);
+            state ^= byte;
+        } else {
+            edge<instrumentation>(4);
+            state += static_cast<uint64_t>(byte) << 3;
+        }
+    }
+    if (state & 1) {
+        edge<instrumentation>(5);
+        state = ~state;
+    } else {
+        edge<instrumentation>(6);
+    }
+    edge<instrumentation>(7);
+    return state;
+}
+
+int main() {
+    // What each instrumented module does when it is loaded
+    __sanitizer_cov_trace_pc_guard_init(guards, guards + EDGE_COUNT);
+    __sanitizer_cov_8bit_counters_init(reinterpret_cast<char*>(counters), reinterpret_cast<char*>(counters + EDGE_COUNT));
+    __sanitizer_cov_pcs_init(pcs, pcs + EDGE_COUNT * 2);
+
+    // Spreads the bytes of the input over the three branches
+    static constexpr uint64_t MIX = 0x9E3779B97F4A7C15ull;
+    bench::run("coverage: none", ITERATIONS, [](uint64_t i) {
+        bench::do_not_optimize(workload<NONE>(i * MIX));
+    });
+    bench::run("coverage: trace-pc-guard", ITERATIONS, [](uint64_t i) {
+        bench::do_not_optimize(workload<GUARDS>(i * MIX));
+    });
+    bench::run("coverage: inline 8-bit counters", ITERATIONS, [](uint64_t i) {
+        bench::do_not_optimize(workload<COUNTERS>(i * MIX));
+    });
+    return 0;
+}
@@ -0,0 +1,4 @@
+// The coverage callbacks, in a translation unit of their own as in an instrumented program, so the compiler
+// cannot inline them into the edges of the benchmark.
+
+#include "antithesis_instrumentation.h"
@@ -0,0 +1,187 @@
+// Measures what the SDK costs an instrumented program on its hot paths, at 1, 8 and 64 threads. The same source
+// is built three times: `bench-sdk-local` runs against the local handler, writing to ANTITHESIS_SDK_LOCAL_OUTPUT
+// (/dev/null unless it is set), `bench-sdk-local-static` does the same with the local handler bound at compile
+// time through ANTITHESIS_SDK_HANDLER, and `bench-sdk-runtime` runs against the fake libvoidstar from tools/, which
+// keeps nothing unless FAKE_LIBVOIDSTAR_CAPTURE_BYTES is set. Every environment variable the handlers and the
+// fake read applies as usual, so FAKE_LIBVOIDSTAR_LATENCY_NS models a slower runtime.
+
+#include "antithesis_sdk.h"
+#include "bench.h"
+
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include <unistd.h>
+
+using antithesis::internal::assertions::Assertion;
+using antithesis::internal::assertions::CatalogRecord;
+using antithesis::internal::assertions::GUIDEPOST_MAXIMIZE;
+using antithesis::internal::assertions::NumericGuidepost;
+
+static constexpr uint64_t SATURATED_ITERATIONS = 100'000'000;
+static constexpr uint64_t EMITTING_ITERATIONS = 1'000'000;
+static constexpr std::array<unsigned, 3> THREAD_COUNTS = { 1, 8, 64 };
+
+static constinit CatalogRecord first_hit_record{ CatalogRecord::ASSERTION_RECORD, false, 1,
+    "{\"antithesis_assert\":{\"assert_type\":\"always\",\"display_type\":\"Always\",\"message\":\"first hit\",\"id\":\"first hit\","
+    "\"location\":{\"class\":\"\",\"function\":\"main\",\"file\":\"sdk.cpp\",\"begin_line\":1,\"begin_column\":1},\"must_hit\":true" };
+static constinit CatalogRecord guidance_record{ CatalogRecord::GUIDANCE_RECORD, false, 2,
+    "{\"antithesis_guidance\":{\"guidance_type\":\"numeric\",\"message\":\"guidance\",\"id\":\"guidance\","
+    "\"location\":{\"class\":\"\",\"function\":\"main\",\"file\":\"sdk.cpp\",\"begin_line\":1,\"begin_column\":1},\"maximize\":true" };
+
+// An assertion site that has not been hit yet; each iteration of the first-hit benchmark hits a different one
+struct FreshAssertion {
+    Assertion assertion{ &first_hit_record };
+};
+
+// Runs `body` at every thread count; `make_body` is called once per run, so each run starts from fresh state.
+template <typename MakeBody>
+void run_all(const char* name, uint64_t iterations, MakeBody&& make_body, bool warm_up = true) {
+    for (unsigned threads : THREAD_COUNTS) {
+        bench::run_threads(name, threads, iterations, make_body(iterations), warm_up);
+    }
+}
+
+// A details object of the size assertions typically carry
+static antithesis::JSON make_flat_details(uint64_t i) {
+    return antithesis::JSON{
+        {"request_id", i},
+        {"shard", static_cast<int>(i & 0xF)},
+        {"leader", (i & 1) == 0},
+        {"state", "replicating"},
+    };
+}
+
+static antithesis::JSON make_nested_details(uint64_t i) {
+    return antithesis::JSON{
+        {"request_id", i},
+        {"latency_ms", static_cast<double>(i & 0xFFF) / 8.0},
+        {"peer", antithesis::JSON{
+            {"host", "replica-2.internal"},
+            {"port", 7000},
+            {"healthy", true},
+        }},
+        {"log_indices", antithesis::JSONArray{ int64_t(1024), int64_t(1025), int64_t(1031) }},
+        {"error", nullptr},
+    };
+}
+
+int main(int, char** argv) {
+    // The handler reads its environment while the catalog is emitted during static initialization, so the
+    // defaults are applied by running the benchmarks again with them set. Local output goes nowhere unless
+    // a destination is given, which would leave emission unmeasured, and capturing records in the fake
+    // runtime would serialize the threads on its lock.
+    if (std::getenv("ANTITHESIS_SDK_LOCAL_OUTPUT") == nullptr || std::getenv("FAKE_LIBVOIDSTAR_CAPTURE_BYTES") == nullptr) {
+        setenv("ANTITHESIS_SDK_LOCAL_OUTPUT", "/dev/null", 0);
+        setenv("FAKE_LIBVOIDSTAR_CAPTURE_BYTES", "0", 0);
+        execv("/proc/self/exe", argv);
+        perror("execv");
+        return 1;
+    }
+
+    run_all("empty loop", SATURATED_ITERATIONS, [](uint64_t) {
+        return [](uint64_t i) { bench::do_not_optimize(i); };
+    });
+
+    run_all("ALWAYS, saturated", SATURATED_ITERATIONS, [](uint64_t) {
+        return [](uint64_t i) {
+            ALWAYS(i != UINT64_MAX, "bench: ALWAYS without details");
+        };
+    });
+
+    run_all("ALWAYS with details, saturated", SATURATED_ITERATIONS, [](uint64_t) {
+        return [](uint64_t i) {
+            ALWAYS(i != UINT64_MAX, "bench: ALWAYS with details", {{"i", i}, {"state", "replicating"}});
+        };
+    });
+
+    run_all("SOMETIMES, saturated", SATURATED_ITERATIONS, [](uint64_t) {
+        return [](uint64_t i) {
+            SOMETIMES((i & 1) == 0, "bench: SOMETIMES without details");
+        };
+    });
+
+    run_all("SOMETIMES with details, saturated", SATURATED_ITERATIONS, [](uint64_t) {
+        return [](uint64_t i) {
+            SOMETIMES((i & 1) == 0, "bench: SOMETIMES with details", {{"i", i}, {"state", "replicating"}});
+        };
+    });
+
+    run_all("first hit of an assertion", EMITTING_ITERATIONS, [](uint64_t iterations) {
+        std::shared_ptr<FreshAssertion[]> sites(new FreshAssertion[iterations]);
+        return [sites](uint64_t i) {
+            sites[i].assertion.check_assertion(true, [] { return antithesis::JSON{}; });
+        };
+    }, false);
+
+    run_all("first hit of an assertion with details", EMITTING_ITERATIONS, [](uint64_t iterations) {
+        std::shared_ptr<FreshAssertion[]> sites(new FreshAssertion[iterations]);
+        return [sites](uint64_t i) {
+            sites[i].assertion.check_assertion(true, [i] { return make_flat_details(i); });
+        };
+    }, false);
+
+    run_all("numeric guidance, no improvement", SATURATED_ITERATIONS, [](uint64_t) {
+        return [](uint64_t i) {
+            int latency = static_cast<int>(i & 0xFFFF);
+            int budget = 1000000;
+            ALWAYS_LESS_THAN(latency, budget, "bench: latency within budget");
+        };
+    });
+
+    // Every thread improves on its own previous value, and on the global extreme whenever it is ahead
+    run_all("numeric guidance, improving", EMITTING_ITERATIONS, [](uint64_t) {
+        std::shared_ptr<NumericGuidepost<int64_t>> guidepost(new NumericGuidepost<int64_t>(&guidance_record, GUIDEPOST_MAXIMIZE));
+        return [guidepost](uint64_t i) {
+            thread_local uint64_t thread_extreme = 0;
+            guidepost->send_guidance(thread_extreme, { static_cast<int64_t>(i), 0 });
+        };
+    }, false);
+
+    run_all("ALWAYS_SOME", EMITTING_ITERATIONS, [](uint64_t) {
+        return [](uint64_t i) {
+            bool primary_up = (i & 1) == 0;
+            bool replica_up = true;
+            ALWAYS_SOME(NAMED_LIST(primary_up, replica_up), "bench: some replica is up");
+        };
+    });
+
+    run_all("SOMETIMES_ALL", EMITTING_ITERATIONS, [](uint64_t) {
+        return [](uint64_t i) {
+            bool committed = (i & 1) == 0;
+            bool acknowledged = (i & 2) == 0;
+            SOMETIMES_ALL(NAMED_LIST(committed, acknowledged), "bench: committed and acknowledged");
+        };
+    });
+
+    run_all("JSON serialization, flat details", SATURATED_ITERATIONS / 10, [](uint64_t) {
+        return [](uint64_t i) {
+            std::string& buffer = antithesis::internal::json::get_thread_buffer();
+            antithesis::internal::json::JSONWriter(buffer).object(make_flat_details(i));
+            bench::do_not_optimize(buffer.data());
+        };
+    });
+
+    run_all("JSON serialization, nested details", SATURATED_ITERATIONS / 10, [](uint64_t) {
+        return [](uint64_t i) {
+            std::string& buffer = antithesis::internal::json::get_thread_buffer();
+            antithesis::internal::json::JSONWriter(buffer).object(make_nested_details(i));
+            bench::do_not_optimize(buffer.data());
+        };
+    });
+
+    run_all("get_random", SATURATED_ITERATIONS / 10, [](uint64_t) {
+        return [](uint64_t) {
+            bench::do_not_optimize(antithesis::get_random());
+        };
+    });
+
+    run_all("random_choice of 10", SATURATED_ITERATIONS / 10, [](uint64_t) {
+        return [](uint64_t) {
+            static constexpr std::array<int, 10> choices = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+            bench::do_not_optimize(*antithesis::random_choice(choices.begin(), choices.end()));
+        };
+    });
+}
@@ -0,0 +1,25 @@
+// Compiles assertions in each of the places the macros are meant to work, which matters since details are
+// passed as lambdas: with and without details in function bodies, without details in namespace-scope
+// initializers, in default member initializers, and with details at namespace scope through a lambda.
+
+#include "antithesis_sdk.h"
+
+static const bool checked_at_namespace_scope = (ALWAYS(true, "scopes: namespace scope"), true);
+
+static const bool checked_with_details_at_namespace_scope = [] {
+    SOMETIMES(true, "scopes: namespace scope with details", {{"scope", "namespace"}});
+    return true;
+}();
+
+struct Member {
+    int value = 1;
+    bool checked = (ALWAYS(value == 1, "scopes: default member initializer", {{"value", value}}), true);
+};
+
+int main() {
+    const int local = 2;
+    REACHABLE("scopes: function body");
+    ALWAYS(local == 2, "scopes: function body with details", {{"local", local}});
+    Member member;
+    return checked_at_namespace_scope && checked_with_details_at_namespace_scope && member.checked ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+// Hits the same assertions from many threads at once, with both outcomes, and checks the local output: every
+// assertion must be in the catalog exactly once, and each outcome of it must be reported exactly once.
+// Run with ANTITHESIS_SDK_LOCAL_OUTPUT set; the test reads that file back.
+
+#include "antithesis_sdk.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+static constexpr unsigned THREADS = 32;
+static constexpr unsigned ITERATIONS = 20000;
+
+static void hit_assertions(unsigned i) {
+    const bool even = (i & 1) == 0;
+    ALWAYS(even, "stress: always, both outcomes");
+    ALWAYS(true, "stress: always, true only");
+    ALWAYS_OR_UNREACHABLE(even, "stress: always or unreachable");
+    SOMETIMES(even, "stress: sometimes, both outcomes", {{"i", i}});
+    SOMETIMES(false, "stress: sometimes, false only");
+    REACHABLE("stress: reachable");
+    UNREACHABLE("stress: unreachable");
+    ALWAYS_GREATER_THAN_OR_EQUAL_TO(i, 0u, "stress: numeric");
+}
+
+// The value of the string member `key` in `line`, which is enough for the records the SDK writes
+static std::string string_member(const std::string& line, const std::string& key) {
+    const std::string pattern = "\"" + key + "\":\"";
+    const size_t start = line.find(pattern);
+    if (start == std::string::npos) {
+        return "";
+    }
+    return line.substr(start + pattern.size(), line.find('"', start + pattern.size()) - start - pattern.size());
+}
+
+int main() {
+    const char* path = std::getenv("ANTITHESIS_SDK_LOCAL_OUTPUT");
+    if (path == nullptr || !path[0]) {
+        fprintf(stderr, "ANTITHESIS_SDK_LOCAL_OUTPUT must be set\n");
+        return 2;
+    }
+
+    std::atomic<bool> start{false};
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < THREADS; t++) {
+        threads.emplace_back([&start, t] {
+            while (!start.load(std::memory_order_acquire)) {}
+            for (unsigned i = 0; i < ITERATIONS; i++) {
+                hit_assertions(i + t);
+            }
+        });
+    }
+    start.store(true, std::memory_order_release);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    antithesis::internal::handlers::get_lib_handler().flush();
+
+    // (id, hit, condition) -> records
+    std::map<std::tuple<std::string, bool, bool>, unsigned> counts;
+    std::ifstream log(path);
+    std::string line;
+    while (std::getline(log, line)) {
+        if (line.rfind("{\"antithesis_assert\":", 0) != 0) {
+            continue;
+        }
+        const bool hit = line.find("\"hit\":true") != std::string::npos;
+        const bool condition = line.find("\"condition\":true") != std::string::npos;
+        counts[{ string_member(line, "id"), hit, condition }]++;
+    }
+
+    const std::vector<std::tuple<std::string, bool, bool>> expected = {
+        { "stress: always, both outcomes", true, true }, { "stress: always, both outcomes", true, false },
+        { "stress: always, true only", true, true },
+        { "stress: always or unreachable", true, true }, { "stress: always or unreachable", true, false },
+        { "stress: sometimes, both outcomes", true, true }, { "stress: sometimes, both outcomes", true, false },
+        { "stress: sometimes, false only", true, false },
+        { "stress: reachable", true, true },
+        { "stress: unreachable", true, false },
+        { "stress: numeric", true, true },
+    };
+
+    int failures = 0;
+    std::map<std::string, unsigned> catalog;
+    for (const auto& [key, count] : counts) {
+        if (!std::get<1>(key)) {
+            catalog[std::get<0>(key)] += count;
+        } else if (count != 1) {
+            fprintf(stderr, "%s (condition %d) was reported %u times\n", std::get<0>(key).c_str(), std::get<2>(key), count);
+            failures++;
+        }
+    }
+    for (const auto& key : expected) {
+        if (counts.find(key) == counts.end()) {
+            fprintf(stderr, "%s (condition %d) was never reported\n", std::get<0>(key).c_str(), std::get<2>(key));
+            failures++;
+        }
+        catalog.emplace(std::get<0>(key), 0);
+    }
+    for (const auto& [id, count] : catalog) {
+        if (count != 1) {
+            fprintf(stderr, "%s is in the catalog %u times\n", id.c_str(), count);
+            failures++;
+        }
+    }
+    if (failures == 0) {
+        printf("%zu assertions hit by %u threads, each in the catalog and each outcome reported once\n", catalog.size(), THREADS);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,2 @@
+// The coverage header is meant to be included from C as well, including C built in a strict ISO mode.
+#include "antithesis_instrumentation.h"
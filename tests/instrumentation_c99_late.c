@@ -0,0 +1,6 @@
+// The same, with the system headers already included in strict mode before the coverage header
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
+#include "antithesis_instrumentation.h"
@@ -0,0 +1,844 @@
+// Reads the local output of the SDK (ANTITHESIS_SDK_LOCAL_OUTPUT) and reports what the run would be judged on:
+// ALWAYS assertions that failed, SOMETIMES and REACHABLE assertions (and any other assertion that must be hit)
+// that were never satisfied, UNREACHABLE assertions that were reached, and the best value every guidepost reached.
+//
+// Usage: antithesis-analyze-log log...    (- for standard input)
+//
+// The logs of all the processes of one run are judged together. Assertions are known from the catalog even if
+// they were never hit. It exits with 1 if anything failed, with 2 if a log could not be read, and 0 otherwise.
+// CBOR output (ANTITHESIS_SDK_LOCAL_OUTPUT_FORMAT=cbor) must be turned into JSON lines with
+// antithesis-cbor-to-jsonl first.
+//
+// Logs are mapped into memory and scanned a line at a time. A record is recognized by its first key, and the
+// part of it that the SDK renders identically for every record of an assertion or guidepost is looked up in a
+// table, so only its outcome, and the numbers of a numeric guidepost, are read from each line, without building
+// a document. Records laid out any other way are read in full into the SDK's JSON types. Assertions and
+// guideposts are told apart by their ids.
+
+#define NO_ANTITHESIS_SDK
+#include "antithesis_sdk.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr std::string_view ASSERT_RECORD = "{\"antithesis_assert\":";
+    constexpr std::string_view GUIDANCE_RECORD = "{\"antithesis_guidance\":";
+    constexpr std::string_view SDK_RECORD = "{\"antithesis_sdk\":";
+    constexpr std::string_view ASSERT_KEY = "antithesis_assert";
+    constexpr std::string_view GUIDANCE_KEY = "antithesis_guidance";
+    // The prefix the SDK renders once for each assertion ends with the first of these, and that of a guidepost
+    // with the second, followed by `true` or `false`. Neither can occur in a string, where its quotes are escaped.
+    constexpr std::string_view MUST_HIT_KEY = "\"must_hit\":";
+    constexpr std::string_view MAXIMIZE_KEY = "\"maximize\":";
+    constexpr std::string_view GUIDANCE_DATA_KEY = ",\"guidance_data\":";
+    constexpr std::string_view GUIDANCE_HIT_SUFFIX = ",\"hit\":true}}";
+    constexpr std::string_view GUIDANCE_CATALOG_SUFFIX = ",\"hit\":false}}";
+
+    // Reads JSON text into the SDK's own JSON types. Strings are kept as views of their still escaped contents,
+    // which is how they are printed, so they are only valid as long as the text that was read.
+    namespace json {
+        using antithesis::JSON;
+        using antithesis::JSONArray;
+        using antithesis::JSONBox;
+        using antithesis::JSONValue;
+
+        // Reads a whole number token without copying it: integers exactly, anything else as a double.
+        bool number(std::string_view token, JSONValue& result) {
+            const char* const end = token.data() + token.size();
+            if (token.find_first_of(".eE") == std::string_view::npos) {
+                if (token.starts_with('-')) {
+                    int64_t value = 0;
+                    const auto [parsed_end, error] = std::from_chars(token.data(), end, value);
+                    result = value;
+                    return error == std::errc() && parsed_end == end;
+                }
+                uint64_t value = 0;
+                const auto [parsed_end, error] = std::from_chars(token.data(), end, value);
+                result = value;
+                return error == std::errc() && parsed_end == end;
+            }
+            // strtod needs a terminated string; no number the SDK writes comes near this long
+            char terminated[64];
+            if (token.empty() || token.size() >= sizeof(terminated)) {
+                return false;
+            }
+            memcpy(terminated, token.data(), token.size());
+            terminated[token.size()] = '\0';
+            char* parsed_end = nullptr;
+            errno = 0;
+            result = strtod(terminated, &parsed_end);
+            return parsed_end == terminated + token.size() && errno == 0;
+        }
+
+        // Numbers are compared as long doubles, which hold every 64-bit integer the SDK sends exactly.
+        bool number(const JSONValue& value, long double& result) {
+            if (const uint64_t* unsigned_number = std::get_if<uint64_t>(&value)) {
+                result = static_cast<long double>(*unsigned_number);
+            } else if (const int64_t* signed_number = std::get_if<int64_t>(&value)) {
+                result = static_cast<long double>(*signed_number);
+            } else if (const double* real = std::get_if<double>(&value)) {
+                result = *real;
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        class Parser {
+        public:
+            explicit Parser(std::string_view text) : text(text) {}
+
+            // Reads the whole text as one object, returning whether it was well formed.
+            bool document(JSON& result) {
+                skip_whitespace();
+                if (!object(result)) {
+                    return false;
+                }
+                skip_whitespace();
+                return position == text.size();
+            }
+
+        private:
+            std::string_view text;
+            size_t position = 0;
+
+            void skip_whitespace() {
+                while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r')) {
+                    position++;
+                }
+            }
+
+            bool consume(char expected) {
+                skip_whitespace();
+                if (position < text.size() && text[position] == expected) {
+                    position++;
+                    return true;
+                }
+                return false;
+            }
+
+            bool string(std::string_view& result) {
+                if (!consume('"')) {
+                    return false;
+                }
+                const size_t start = position;
+                for (; position < text.size(); position++) {
+                    if (text[position] == '\\') {
+                        position++;
+                    } else if (text[position] == '"') {
+                        result = text.substr(start, position - start);
+                        position++;
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            bool object(JSON& result) {
+                if (!consume('{')) {
+                    return false;
+                }
+                if (consume('}')) {
+                    return true;
+                }
+                do {
+                    std::string_view key;
+                    JSONValue field;
+                    if (!string(key) || !consume(':') || !value(field)) {
+                        return false;
+                    }
+                    result[key] = std::move(field);
+                } while (consume(','));
+                return consume('}');
+            }
+
+            bool array(JSONArray& result) {
+                if (!consume('[')) {
+                    return false;
+                }
+                if (consume(']')) {
+                    return true;
+                }
+                do {
+                    if (!value(result.emplace_back())) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume(']');
+            }
+
+            bool value(JSONValue& result) {
+                skip_whitespace();
+                if (position >= text.size()) {
+                    return false;
+                }
+                switch (text[position]) {
+                    case '{': {
+                        JSON nested;
+                        if (!object(nested)) {
+                            return false;
+                        }
+                        result = JSONBox(std::move(nested));
+                        return true;
+                    }
+                    case '[': {
+                        JSONArray elements;
+                        if (!array(elements)) {
+                            return false;
+                        }
+                        result = std::move(elements);
+                        return true;
+                    }
+                    case '"': {
+                        std::string_view contents;
+                        if (!string(contents)) {
+                            return false;
+                        }
+                        result = contents;
+                        return true;
+                    }
+                    default:
+                        return literal(result);
+                }
+            }
+
+            // A number, `true`, `false` or `null`
+            bool literal(JSONValue& result) {
+                const size_t start = position;
+                while (position < text.size() && text[position] != ',' && text[position] != '}' && text[position] != ']' &&
+                       text[position] != ' ' && text[position] != '\t' && text[position] != '\n' && text[position] != '\r') {
+                    position++;
+                }
+                const std::string_view token = text.substr(start, position - start);
+                if (token == "true" || token == "false") {
+                    result = token == "true";
+                    return true;
+                }
+                if (token == "null") {
+                    result = nullptr;
+                    return true;
+                }
+                return number(token, result);
+            }
+        };
+
+        // Returns the member `key` of `object`, or nullptr if it has none.
+        const JSONValue* member(const JSON& object, std::string_view key) {
+            const JSON::Field* field = object.find(key);
+            return field == object.end() ? nullptr : &field->second;
+        }
+
+        // Returns the member `key` of `object` if it is itself an object, and an empty object otherwise.
+        const JSON& object_member(const JSON& object, std::string_view key) {
+            static const JSON empty;
+            const JSONValue* value = member(object, key);
+            const JSONBox* box = value != nullptr ? std::get_if<JSONBox>(value) : nullptr;
+            return box != nullptr ? box->get() : empty;
+        }
+
+        std::string_view string_member(const JSON& object, std::string_view key) {
+            const JSONValue* value = member(object, key);
+            const std::string_view* contents = value != nullptr ? std::get_if<std::string_view>(value) : nullptr;
+            return contents != nullptr ? *contents : std::string_view();
+        }
+
+        bool bool_member(const JSON& object, std::string_view key, bool& result) {
+            const JSONValue* value = member(object, key);
+            const bool* found = value != nullptr ? std::get_if<bool>(value) : nullptr;
+            if (found != nullptr) {
+                result = *found;
+            }
+            return found != nullptr;
+        }
+
+        bool number_member(const JSON& object, std::string_view key, long double& result) {
+            const JSONValue* value = member(object, key);
+            return value != nullptr && number(*value, result);
+        }
+
+        // Writes back what the parser read
+        void render(std::string& output, const JSONValue& value);
+
+        void render(std::string& output, const JSON& object) {
+            output += '{';
+            bool first = true;
+            for (const JSON::Field& field : object) {
+                output += first ? "\"" : ",\"";
+                output += field.first.get();
+                output += "\":";
+                render(output, field.second);
+                first = false;
+            }
+            output += '}';
+        }
+
+        void render(std::string& output, const JSONValue& value) {
+            char number[32];
+            if (const JSONBox* box = std::get_if<JSONBox>(&value)) {
+                render(output, box->get());
+            } else if (const JSONArray* elements = std::get_if<JSONArray>(&value)) {
+                output += '[';
+                for (size_t i = 0; i < elements->size(); i++) {
+                    output += i == 0 ? "" : ",";
+                    render(output, (*elements)[i]);
+                }
+                output += ']';
+            } else if (const std::string_view* contents = std::get_if<std::string_view>(&value)) {
+                output += '"';
+                output += *contents;
+                output += '"';
+            } else if (const bool* boolean = std::get_if<bool>(&value)) {
+                output += *boolean ? "true" : "false";
+            } else if (const uint64_t* unsigned_number = std::get_if<uint64_t>(&value)) {
+                snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(*unsigned_number));
+                output += number;
+            } else if (const int64_t* signed_number = std::get_if<int64_t>(&value)) {
+                snprintf(number, sizeof(number), "%lld", static_cast<long long>(*signed_number));
+                output += number;
+            } else if (const double* real = std::get_if<double>(&value)) {
+                snprintf(number, sizeof(number), "%.17g", *real);
+                output += number;
+            } else {
+                output += "null";
+            }
+        }
+    }
+
+    // An assertion or guidepost, identified by its id, which is the same wherever in the program it is made
+    struct Site {
+        bool is_guidance = false;
+        std::string id;
+        std::string display_type;
+        std::string assert_type;
+        // Where it was first seen
+        std::string file;
+        std::string function;
+        std::string line;
+        bool must_hit = false;
+        bool is_unreachable = false;
+        bool maximize = false;
+        bool numeric = false;
+
+        uint64_t true_hits = 0;
+        uint64_t false_hits = 0;
+        // The details of the first failing hit of an assertion
+        std::string first_failure_details;
+        // The best guidance seen, scored so that higher is better, and the data it came with
+        bool has_extreme = false;
+        long double extreme = 0;
+        std::string extreme_data;
+    };
+
+    // Hashes a site prefix from a few of its words rather than all of its bytes. The prefixes of two sites differ
+    // in length, or in their message, near the middle, or their location, which ends them; the rare collision is
+    // settled by comparing the prefixes in full.
+    struct PrefixHash {
+        size_t operator()(std::string_view prefix) const {
+            if (prefix.size() < 64) {
+                return std::hash<std::string_view>()(prefix);
+            }
+            uint64_t hash = prefix.size();
+            for (const size_t offset : { prefix.size() / 2, prefix.size() - 32, prefix.size() - 24, prefix.size() - 16, prefix.size() - 8 }) {
+                uint64_t word;
+                memcpy(&word, prefix.data() + offset, sizeof(word));
+                hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+                hash ^= hash >> 32;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    class Analyzer {
+    public:
+        uint64_t records = 0;
+        uint64_t processes = 0;
+        uint64_t malformed = 0;
+        uint64_t bytes = 0;
+
+        void scan(std::string_view log) {
+            bytes += log.size();
+            const char* position = log.data();
+            const char* const end = log.data() + log.size();
+            while (position < end) {
+                const char* newline = static_cast<const char*>(memchr(position, '\n', static_cast<size_t>(end - position)));
+                const char* line_end = newline != nullptr ? newline : end;
+                const std::string_view line(position, static_cast<size_t>(line_end - position));
+                if (!line.empty()) {
+                    records++;
+                    record(line);
+                }
+                position = line_end + 1;
+            }
+        }
+
+        // Prints the report, returning whether anything failed.
+        bool report(FILE* output) const {
+            std::vector<const Site*> failed_always;
+            std::vector<const Site*> unsatisfied;
+            std::vector<const Site*> reached_unreachable;
+            std::vector<const Site*> guideposts;
+            for (const auto& site : sites) {
+                if (site->is_guidance) {
+                    if (site->has_extreme) {
+                        guideposts.push_back(site.get());
+                    }
+                } else if (site->is_unreachable) {
+                    if (site->true_hits + site->false_hits > 0) {
+                        reached_unreachable.push_back(site.get());
+                    }
+                } else if (site->assert_type == "always" && site->false_hits > 0) {
+                    failed_always.push_back(site.get());
+                } else if (site->must_hit && (site->true_hits + site->false_hits == 0 ||
+                           (site->assert_type == "sometimes" && site->true_hits == 0))) {
+                    unsatisfied.push_back(site.get());
+                }
+            }
+
+            fprintf(output, "Records: %llu, processes: %llu, assertions and guideposts: %llu\n",
+                static_cast<unsigned long long>(records), static_cast<unsigned long long>(processes),
+                static_cast<unsigned long long>(sites.size()));
+            if (malformed > 0) {
+                fprintf(output, "Records that could not be read: %llu\n", static_cast<unsigned long long>(malformed));
+            }
+
+            fprintf(output, "\nALWAYS assertions that failed: %zu\n", failed_always.size());
+            for (const Site* site : failed_always) {
+                print_site(output, *site);
+                fprintf(output, "    failures: %llu, the first with details %s\n",
+                    static_cast<unsigned long long>(site->false_hits), site->first_failure_details.c_str());
+            }
+
+            fprintf(output, "\nAssertions never satisfied: %zu\n", unsatisfied.size());
+            for (const Site* site : unsatisfied) {
+                print_site(output, *site);
+                fprintf(output, site->true_hits + site->false_hits == 0 ? "    never reached\n" : "    reached, but never true\n");
+            }
+
+            fprintf(output, "\nUNREACHABLE assertions reached: %zu\n", reached_unreachable.size());
+            for (const Site* site : reached_unreachable) {
+                print_site(output, *site);
+                fprintf(output, "    hits: %llu, the first with details %s\n",
+                    static_cast<unsigned long long>(site->true_hits + site->false_hits), site->first_failure_details.c_str());
+            }
+
+            fprintf(output, "\nGuidance extremes: %zu\n", guideposts.size());
+            for (const Site* site : guideposts) {
+                print_site(output, *site);
+                fprintf(output, "    %s %s: %s\n", site->numeric ? "numeric" : "boolean",
+                    site->maximize ? "maximized" : "minimized", site->extreme_data.c_str());
+            }
+
+            return !failed_always.empty() || !unsatisfied.empty() || !reached_unreachable.empty();
+        }
+
+    private:
+        // Sites in the order they were first seen, so the report follows the logs
+        std::vector<std::unique_ptr<Site>> sites;
+        std::unordered_map<std::string, Site*> assertions_by_id;
+        std::unordered_map<std::string, Site*> guideposts_by_id;
+        // The prefixes the SDK rendered for the sites, keyed by views into the logs, which stay mapped until the
+        // report is printed. One site has a prefix for every location it is made at.
+        std::unordered_map<std::string_view, Site*, PrefixHash> sites_by_prefix;
+        // The length of the shortest prefix known for an assertion, and for a guidepost
+        size_t shortest_assertion_prefix = 0;
+        size_t shortest_guidance_prefix = 0;
+
+        void record(std::string_view line) {
+            if (line.starts_with(ASSERT_RECORD)) {
+                assertion(line);
+            } else if (line.starts_with(GUIDANCE_RECORD)) {
+                guidance(line);
+            } else if (line.starts_with(SDK_RECORD)) {
+                processes++;
+            }
+            // Anything else is an event sent by the program
+        }
+
+        // Returns the prefix of `line` that ends after the boolean following the first `key` from `start`, or an
+        // empty view.
+        static std::string_view site_prefix(std::string_view line, std::string_view key, size_t start = 0) {
+            if (start >= line.size()) {
+                return {};
+            }
+            // memmem skips ahead much faster than std::string_view::find, which stops at every quote
+            const void* found = memmem(line.data() + start, line.size() - start, key.data(), key.size());
+            if (found == nullptr) {
+                return {};
+            }
+            const size_t value = static_cast<size_t>(static_cast<const char*>(found) - line.data()) + key.size();
+            if (line.compare(value, 4, "true") == 0) {
+                return line.substr(0, value + 4);
+            }
+            if (line.compare(value, 5, "false") == 0) {
+                return line.substr(0, value + 5);
+            }
+            return {};
+        }
+
+        // Reads a whole record, returning whether it holds an object under `key`, which `fields` is then set to.
+        static bool read_record(std::string_view text, std::string_view key, json::JSON& record, const json::JSON*& fields) {
+            if (!json::Parser(text).document(record)) {
+                return false;
+            }
+            const json::JSONValue* value = json::member(record, key);
+            const json::JSONBox* box = value != nullptr ? std::get_if<json::JSONBox>(value) : nullptr;
+            fields = box != nullptr ? &box->get() : nullptr;
+            return fields != nullptr;
+        }
+
+        // Returns the site the `fields` of a record belong to, creating it the first time its id is seen.
+        Site* find_site(const json::JSON& fields, bool is_guidance) {
+            auto& sites_by_id = is_guidance ? guideposts_by_id : assertions_by_id;
+            std::string id(json::string_member(fields, "id"));
+            auto found = sites_by_id.find(id);
+            if (found != sites_by_id.end()) {
+                return found->second;
+            }
+            Site* site = sites.emplace_back(std::make_unique<Site>()).get();
+            site->is_guidance = is_guidance;
+            site->id = id;
+            site->display_type = json::string_member(fields, "display_type");
+            site->assert_type = json::string_member(fields, "assert_type");
+            site->is_unreachable = site->display_type == "Unreachable";
+            json::bool_member(fields, "must_hit", site->must_hit);
+            json::bool_member(fields, "maximize", site->maximize);
+            site->numeric = json::string_member(fields, "guidance_type") == "numeric";
+            const json::JSON& location = json::object_member(fields, "location");
+            site->file = json::string_member(location, "file");
+            site->function = json::string_member(location, "function");
+            if (const json::JSONValue* line = json::member(location, "begin_line")) {
+                json::render(site->line, *line);
+            }
+            sites_by_id.emplace(std::move(id), site);
+            return site;
+        }
+
+        // Returns the site prefix of `line`, and sets `site` if the prefix is a known one. Every known prefix is at
+        // least `shortest` bytes long, so `key` is first looked for where it would end the shortest of them. What
+        // that finds is only trusted if it is a known prefix, since a known prefix holds `key` nowhere earlier.
+        std::string_view find_known_prefix(std::string_view line, std::string_view key, size_t shortest, Site*& site) const {
+            site = nullptr;
+            const size_t skip = key.size() + 5;
+            if (shortest > skip) {
+                const std::string_view prefix = site_prefix(line, key, shortest - skip);
+                auto found = prefix.empty() ? sites_by_prefix.end() : sites_by_prefix.find(prefix);
+                if (found != sites_by_prefix.end()) {
+                    site = found->second;
+                    return prefix;
+                }
+            }
+            return site_prefix(line, key);
+        }
+
+        // Returns the site of a record that starts with `prefix`, or nullptr if the prefix can't be read.
+        Site* find_prefix_site(std::string_view prefix, std::string_view key, bool is_guidance) {
+            auto found = sites_by_prefix.find(prefix);
+            if (found != sites_by_prefix.end()) {
+                return found->second;
+            }
+            // The prefix is an object left open; closing it lets it be read like any other
+            std::string object(prefix);
+            object += "}}";
+            json::JSON record;
+            const json::JSON* fields = nullptr;
+            if (!read_record(object, key, record, fields)) {
+                return nullptr;
+            }
+            Site* site = find_site(*fields, is_guidance);
+            sites_by_prefix.emplace(prefix, site);
+            size_t& shortest = is_guidance ? shortest_guidance_prefix : shortest_assertion_prefix;
+            shortest = shortest == 0 ? prefix.size() : std::min(shortest, prefix.size());
+            return site;
+        }
+
+        // `details` makes the text of the details, which is only kept for the first failure.
+        template <typename Details>
+        static void count_hit(Site& site, bool condition, Details&& details) {
+            condition ? site.true_hits++ : site.false_hits++;
+            // The failure is what is reported: an ALWAYS that is false, or an UNREACHABLE that is reached at all
+            const bool failure = !condition || site.is_unreachable;
+            if (failure && site.first_failure_details.empty()) {
+                site.first_failure_details = details();
+            }
+        }
+
+        // The SDK's macros render `...,"must_hit":B,"hit":B,"condition":B,"details":{...}}}`, of which only the
+        // part after the prefix is read. Records in any other order, like those of `assert_raw`, which starts
+        // with `hit`, are read in full.
+        void assertion(std::string_view line) {
+            Site* site = nullptr;
+            const std::string_view prefix = find_known_prefix(line, MUST_HIT_KEY, shortest_assertion_prefix, site);
+            const std::string_view rest = line.substr(prefix.size());
+            const bool is_hit = rest.starts_with(",\"hit\":true,\"condition\":");
+            if (!prefix.empty() && (is_hit || rest.starts_with(",\"hit\":false"))) {
+                site = site != nullptr ? site : find_prefix_site(prefix, ASSERT_KEY, false);
+            } else {
+                site = nullptr;
+            }
+            if (site != nullptr) {
+                if (!is_hit) {
+                    return; // A catalog record
+                }
+                count_hit(*site, rest.compare(24, 4, "true") == 0, [rest] {
+                    const size_t details = rest.find("\"details\":");
+                    return details == std::string_view::npos ? std::string("{}") :
+                        std::string(rest.substr(details + 10, rest.size() - details - 10 - 2));
+                });
+                return;
+            }
+
+            json::JSON record;
+            const json::JSON* fields = nullptr;
+            bool hit = false;
+            bool condition = false;
+            if (!read_record(line, ASSERT_KEY, record, fields) || !json::bool_member(*fields, "hit", hit) ||
+                (hit && !json::bool_member(*fields, "condition", condition))) {
+                malformed++;
+                return;
+            }
+            site = find_site(*fields, false);
+            if (hit) {
+                count_hit(*site, condition, [fields] {
+                    std::string details;
+                    json::render(details, json::object_member(*fields, "details"));
+                    return details;
+                });
+            }
+        }
+
+        // The SDK renders `...,"maximize":B,"guidance_data":{...},"hit":true}}`, or `...,"maximize":B,"hit":false}}`
+        // in the catalog, of which only the part after the prefix is read. Records in any other order are read in full.
+        void guidance(std::string_view line) {
+            Site* site = nullptr;
+            const std::string_view prefix = find_known_prefix(line, MAXIMIZE_KEY, shortest_guidance_prefix, site);
+            const std::string_view rest = line.substr(prefix.size());
+            const bool is_hit = rest.starts_with(GUIDANCE_DATA_KEY) && rest.ends_with(GUIDANCE_HIT_SUFFIX);
+            if (!prefix.empty() && (is_hit || rest == GUIDANCE_CATALOG_SUFFIX)) {
+                site = site != nullptr ? site : find_prefix_site(prefix, GUIDANCE_KEY, true);
+            } else {
+                site = nullptr;
+            }
+            if (site != nullptr) {
+                if (!is_hit) {
+                    return; // A catalog record
+                }
+                const std::string_view text = rest.substr(GUIDANCE_DATA_KEY.size(),
+                    rest.size() - GUIDANCE_DATA_KEY.size() - GUIDANCE_HIT_SUFFIX.size());
+                long double left = 0;
+                long double right = 0;
+                if (site->numeric && read_left_right(text, left, right)) {
+                    improve(*site, left - right, [text] { return std::string(text); });
+                    return;
+                }
+                json::JSON data;
+                if (!json::Parser(text).document(data)) {
+                    malformed++;
+                    return;
+                }
+                guide(*site, data, [text] { return std::string(text); });
+                return;
+            }
+
+            json::JSON record;
+            const json::JSON* fields = nullptr;
+            bool hit = false;
+            if (!read_record(line, GUIDANCE_KEY, record, fields) || !json::bool_member(*fields, "hit", hit)) {
+                malformed++;
+                return;
+            }
+            site = find_site(*fields, true);
+            if (hit) {
+                const json::JSON& data = json::object_member(*fields, "guidance_data");
+                guide(*site, data, [&data] {
+                    std::string text;
+                    json::render(text, data);
+                    return text;
+                });
+            }
+        }
+
+        // Boolean guidance steers toward all of the values being true, or all of them false
+        static long double count_true(const json::JSONValue& value) {
+            if (const bool* boolean = std::get_if<bool>(&value)) {
+                return *boolean ? 1 : 0;
+            }
+            long double count = 0;
+            if (const json::JSONBox* box = std::get_if<json::JSONBox>(&value)) {
+                for (const json::JSON::Field& field : box->get()) {
+                    count += count_true(field.second);
+                }
+            } else if (const json::JSONArray* elements = std::get_if<json::JSONArray>(&value)) {
+                for (const json::JSONValue& element : *elements) {
+                    count += count_true(element);
+                }
+            }
+            return count;
+        }
+
+        // Reads numeric guidance data as the SDK renders it, `{"left":L,"right":R}`, without building a document.
+        static bool read_left_right(std::string_view text, long double& left, long double& right) {
+            constexpr std::string_view LEFT_KEY = "{\"left\":";
+            constexpr std::string_view RIGHT_KEY = ",\"right\":";
+            if (!text.starts_with(LEFT_KEY) || !text.ends_with('}')) {
+                return false;
+            }
+            const size_t right_key = text.find(RIGHT_KEY, LEFT_KEY.size());
+            if (right_key == std::string_view::npos) {
+                return false;
+            }
+            const size_t right_start = right_key + RIGHT_KEY.size();
+            return read_number(text.substr(LEFT_KEY.size(), right_key - LEFT_KEY.size()), left) &&
+                read_number(text.substr(right_start, text.size() - right_start - 1), right);
+        }
+
+        static bool read_number(std::string_view token, long double& result) {
+            // Most guidance compares integers, which are read straight into the result
+            int64_t integer = 0;
+            const auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), integer);
+            if (error == std::errc() && end == token.data() + token.size()) {
+                result = static_cast<long double>(integer);
+                return true;
+            }
+            json::JSONValue value;
+            return json::number(token, value) && json::number(value, result);
+        }
+
+        // `text` makes the text of the data, which is only kept while it is the best seen.
+        template <typename Text>
+        void guide(Site& site, const json::JSON& data, Text&& text) {
+            long double score = 0;
+            if (site.numeric) {
+                // The SDK guides on the gap between the two sides of the comparison
+                long double left = 0;
+                long double right = 0;
+                if (!json::number_member(data, "left", left) || !json::number_member(data, "right", right)) {
+                    malformed++;
+                    return;
+                }
+                score = left - right;
+            } else {
+                for (const json::JSON::Field& field : data) {
+                    score += count_true(field.second);
+                }
+            }
+            improve(site, score, std::forward<Text>(text));
+        }
+
+        // `score` is higher the closer the data is to what the guidepost steers toward, before `maximize` is applied.
+        template <typename Text>
+        static void improve(Site& site, long double score, Text&& text) {
+            if (!site.maximize) {
+                score = -score;
+            }
+            if (!site.has_extreme || score > site.extreme) {
+                site.has_extreme = true;
+                site.extreme = score;
+                site.extreme_data = text();
+            }
+        }
+
+        static void print_site(FILE* output, const Site& site) {
+            fprintf(output, "  \"%s\" (%s) at %s:%s in %s\n", site.id.c_str(),
+                site.is_guidance ? "guidance" : site.display_type.c_str(), site.file.c_str(), site.line.c_str(), site.function.c_str());
+        }
+    };
+
+    // A log mapped into memory, or read in full when it is not a regular file
+    class Log {
+    public:
+        ~Log() {
+            if (mapping != nullptr) {
+                munmap(mapping, size);
+            }
+        }
+
+        bool open(const char* program, const char* path) {
+            const bool is_stdin = strcmp(path, "-") == 0;
+            const int fd = is_stdin ? STDIN_FILENO : ::open(path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                fprintf(stderr, "%s: cannot open %s: %s\n", program, path, strerror(errno));
+                return false;
+            }
+            struct stat stat_buf;
+            if (fstat(fd, &stat_buf) == 0 && S_ISREG(stat_buf.st_mode)) {
+                size = static_cast<size_t>(stat_buf.st_size);
+                if (size > 0) {
+                    mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (mapping == MAP_FAILED) {
+                        mapping = nullptr;
+                        fprintf(stderr, "%s: cannot map %s: %s\n", program, path, strerror(errno));
+                        close_unless_stdin(fd, is_stdin);
+                        return false;
+                    }
+                    madvise(mapping, size, MADV_SEQUENTIAL);
+                }
+            } else {
+                char chunk[1 << 16];
+                ssize_t count;
+                while ((count = read(fd, chunk, sizeof(chunk))) != 0) {
+                    if (count < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (count < 0) {
+                        fprintf(stderr, "%s: cannot read %s: %s\n", program, path, strerror(errno));
+                        close_unless_stdin(fd, is_stdin);
+                        return false;
+                    }
+                    contents.append(chunk, static_cast<size_t>(count));
+                }
+            }
+            close_unless_stdin(fd, is_stdin);
+            return true;
+        }
+
+        std::string_view text() const {
+            return mapping != nullptr ? std::string_view(static_cast<const char*>(mapping), size) : std::string_view(contents);
+        }
+
+    private:
+        void* mapping = nullptr;
+        size_t size = 0;
+        std::string contents;
+
+        static void close_unless_stdin(int fd, bool is_stdin) {
+            if (!is_stdin) {
+                close(fd);
+            }
+        }
+    };
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s log...    (- for standard input)\n", argv[0]);
+        return 2;
+    }
+
+    // Every log stays mapped until the report is printed, since the analyzer keeps views into them
+    std::vector<std::unique_ptr<Log>> logs;
+    Analyzer analyzer;
+    for (int i = 1; i < argc; i++) {
+        Log* log = logs.emplace_back(std::make_unique<Log>()).get();
+        if (!log->open(argv[0], argv[i])) {
+            return 2;
+        }
+        analyzer.scan(log->text());
+    }
+    return analyzer.report(stdout) ? 1 : 0;
+}
@@ -0,0 +1,365 @@
+// Decodes the CBOR local output of the SDK (ANTITHESIS_SDK_LOCAL_OUTPUT_FORMAT=cbor) back into the JSON lines
+// that the SDK writes by default, one record per line.
+//
+// Usage: antithesis-cbor-to-jsonl [input [output]]    (standard input and output by default)
+//
+// The input is a sequence of stringref namespaces (tag 256) holding arrays of records, in which values may open
+// namespaces of their own. Output cut short by a crash is decoded up to the last complete record.
+
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    constexpr uint64_t SELF_DESCRIBED_TAG = 55799;
+    constexpr uint64_t STRINGREF_NAMESPACE_TAG = 256;
+    constexpr uint64_t STRINGREF_TAG = 25;
+    constexpr uint8_t BREAK = 0xFF;
+
+    // Matches `stringref_min_length` in antithesis_sdk.h
+    constexpr size_t stringref_min_length(size_t count) {
+        return count < 24 ? 3 : count < 256 ? 4 : count < 65536 ? 5 : count < 4294967296ull ? 7 : 11;
+    }
+
+    struct Truncated {};
+    struct Malformed {
+        const char* reason;
+    };
+
+    class Decoder {
+    public:
+        Decoder(std::string_view input, FILE* output) : input(input), output(output) {}
+
+        // Returns false if the input ends in the middle of a record.
+        bool run() {
+            try {
+                while (position < input.size()) {
+                    top_level();
+                }
+            } catch (const Truncated&) {
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        std::string_view input;
+        FILE* output;
+        size_t position = 0;
+        std::vector<std::string> strings;
+        bool in_namespace = false;
+        std::string line;
+
+        uint8_t next_byte() {
+            if (position >= input.size()) {
+                throw Truncated{};
+            }
+            return static_cast<uint8_t>(input[position++]);
+        }
+
+        uint8_t peek_byte() {
+            if (position >= input.size()) {
+                throw Truncated{};
+            }
+            return static_cast<uint8_t>(input[position]);
+        }
+
+        uint64_t argument(uint8_t initial) {
+            const uint8_t info = initial & 0x1F;
+            if (info < 24) {
+                return info;
+            }
+            if (info > 27) {
+                throw Malformed{ "unsupported length encoding" };
+            }
+            const int bytes = 1 << (info - 24);
+            uint64_t value = 0;
+            for (int i = 0; i < bytes; i++) {
+                value = (value << 8) | next_byte();
+            }
+            return value;
+        }
+
+        std::string_view take(uint64_t length) {
+            if (length > input.size() - position) {
+                throw Truncated{};
+            }
+            std::string_view bytes = input.substr(position, length);
+            position += length;
+            return bytes;
+        }
+
+        // A record, a namespace of records, or a tag in front of either
+        void top_level() {
+            const uint8_t initial = next_byte();
+            if (initial >> 5 == 6) {
+                const uint64_t tag = argument(initial);
+                if (tag == SELF_DESCRIBED_TAG) {
+                    return;
+                }
+                if (tag == STRINGREF_NAMESPACE_TAG) {
+                    records_in_namespace();
+                    return;
+                }
+                throw Malformed{ "unexpected tag" };
+            }
+            position--;
+            record();
+        }
+
+        void records_in_namespace() {
+            strings.clear();
+            in_namespace = true;
+            const uint8_t initial = next_byte();
+            if (initial >> 5 != 4) {
+                throw Malformed{ "expected an array of records" };
+            }
+            if ((initial & 0x1F) == 31) {
+                // The final break is missing if the program did not exit normally
+                while (position < input.size() && peek_byte() != BREAK) {
+                    record();
+                }
+                if (position < input.size()) {
+                    position++;
+                }
+            } else {
+                for (uint64_t count = argument(initial); count > 0; count--) {
+                    record();
+                }
+            }
+            in_namespace = false;
+        }
+
+        void record() {
+            line.clear();
+            const size_t start = position;
+            const uint8_t initial = next_byte();
+            if (initial >> 5 == 3) {
+                // A record kept as its original text, as written before records had namespaces of their own
+                line.append(string_item(initial));
+            } else if (initial >> 5 == 6 && argument(initial) == STRINGREF_NAMESPACE_TAG && peek_byte() >> 5 == 3) {
+                // A record the SDK was given as text is kept as it is
+                std::vector<std::string> outer;
+                outer.swap(strings);
+                line.append(string_item(next_byte()));
+                strings.swap(outer);
+            } else {
+                position = start;
+                value();
+            }
+            line.push_back('\n');
+            fwrite(line.data(), 1, line.size(), output);
+        }
+
+        std::string_view string_item(uint8_t initial) {
+            std::string_view text = take(argument(initial));
+            if (in_namespace && text.size() >= stringref_min_length(strings.size())) {
+                strings.emplace_back(text);
+            }
+            return text;
+        }
+
+        void value() {
+            const uint8_t initial = next_byte();
+            switch (initial >> 5) {
+                case 0:
+                    number(argument(initial));
+                    break;
+                case 1: {
+                    const uint64_t magnitude = argument(initial);
+                    if (magnitude == UINT64_MAX) {
+                        line.append("-18446744073709551616");
+                    } else {
+                        line.push_back('-');
+                        number(magnitude + 1);
+                    }
+                    break;
+                }
+                case 2:
+                case 3:
+                    string(string_item(initial));
+                    break;
+                case 4:
+                    container(initial, false);
+                    break;
+                case 5:
+                    container(initial, true);
+                    break;
+                case 6: {
+                    const uint64_t tag = argument(initial);
+                    if (tag == STRINGREF_NAMESPACE_TAG) {
+                        std::vector<std::string> outer;
+                        outer.swap(strings);
+                        const bool outer_in_namespace = in_namespace;
+                        in_namespace = true;
+                        value();
+                        in_namespace = outer_in_namespace;
+                        strings.swap(outer);
+                    } else if (tag == STRINGREF_TAG) {
+                        const uint8_t index_initial = next_byte();
+                        const uint64_t index = argument(index_initial);
+                        if (index_initial >> 5 != 0 || index >= strings.size()) {
+                            throw Malformed{ "invalid string reference" };
+                        }
+                        string(strings[index]);
+                    } else {
+                        // Other tags carry no meaning for SDK records
+                        value();
+                    }
+                    break;
+                }
+                default:
+                    simple(initial);
+            }
+        }
+
+        void container(uint8_t initial, bool is_map) {
+            line.push_back(is_map ? '{' : '[');
+            const bool indefinite = (initial & 0x1F) == 31;
+            uint64_t remaining = indefinite ? 0 : argument(initial);
+            bool first = true;
+            while (indefinite ? peek_byte() != BREAK : remaining-- > 0) {
+                if (!first) {
+                    line.push_back(',');
+                }
+                first = false;
+                value();
+                if (is_map) {
+                    line.push_back(':');
+                    value();
+                }
+            }
+            if (indefinite) {
+                position++;
+            }
+            line.push_back(is_map ? '}' : ']');
+        }
+
+        void simple(uint8_t initial) {
+            switch (initial) {
+                case 0xF4: line.append("false"); return;
+                case 0xF5: line.append("true"); return;
+                case 0xF6:
+                case 0xF7: line.append("null"); return;
+                case 0xF9: {
+                    const uint16_t bits = static_cast<uint16_t>(argument(initial));
+                    floating(half_to_double(bits));
+                    return;
+                }
+                case 0xFA:
+                    floating(std::bit_cast<float>(static_cast<uint32_t>(argument(initial))));
+                    return;
+                case 0xFB:
+                    floating(std::bit_cast<double>(argument(initial)));
+                    return;
+                default:
+                    throw Malformed{ "unsupported simple value" };
+            }
+        }
+
+        static double half_to_double(uint16_t bits) {
+            const int exponent = (bits >> 10) & 0x1F;
+            const int mantissa = bits & 0x3FF;
+            double value;
+            if (exponent == 0) {
+                value = std::ldexp(mantissa, -24);
+            } else if (exponent == 31) {
+                value = mantissa == 0 ? HUGE_VAL : NAN;
+            } else {
+                value = std::ldexp(mantissa + 1024, exponent - 25);
+            }
+            return bits & 0x8000 ? -value : value;
+        }
+
+        void number(uint64_t value) {
+            std::array<char, 32> digits;
+            auto result = std::to_chars(digits.data(), digits.data() + digits.size(), value);
+            line.append(digits.data(), result.ptr);
+        }
+
+        // Floats and doubles are formatted as their own type, as the SDK's JSONWriter does
+        template <typename Floating>
+        void floating(Floating value) {
+            std::array<char, 32> digits;
+            auto result = std::to_chars(digits.data(), digits.data() + digits.size(), value);
+            line.append(digits.data(), result.ptr);
+        }
+
+        // Escapes like the SDK's JSONWriter
+        void string(std::string_view text) {
+            static constexpr char HEX[] = "0123456789ABCDEF";
+            line.push_back('"');
+            for (const char c : text) {
+                switch (c) {
+                    case '\t': line.append("\\t"); break;
+                    case '\b': line.append("\\b"); break;
+                    case '\n': line.append("\\n"); break;
+                    case '\f': line.append("\\f"); break;
+                    case '\r': line.append("\\r"); break;
+                    case '"': line.append("\\\""); break;
+                    case '\\': line.append("\\\\"); break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            line.append("\\u00");
+                            line.push_back(HEX[(c >> 4) & 0x0F]);
+                            line.push_back(HEX[c & 0x0F]);
+                        } else {
+                            line.push_back(c);
+                        }
+                }
+            }
+            line.push_back('"');
+        }
+    };
+
+    bool read_all(FILE* file, std::string& contents) {
+        std::array<char, 1 << 16> chunk;
+        size_t read;
+        while ((read = fread(chunk.data(), 1, chunk.size(), file)) > 0) {
+            contents.append(chunk.data(), read);
+        }
+        return !ferror(file);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 3) {
+        fprintf(stderr, "usage: %s [input [output]]\n", argv[0]);
+        return 2;
+    }
+    FILE* input = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if (input == nullptr) {
+        fprintf(stderr, "%s: cannot open %s: %s\n", argv[0], argv[1], strerror(errno));
+        return 1;
+    }
+    FILE* output = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (output == nullptr) {
+        fprintf(stderr, "%s: cannot open %s: %s\n", argv[0], argv[2], strerror(errno));
+        return 1;
+    }
+
+    std::string contents;
+    if (!read_all(input, contents)) {
+        fprintf(stderr, "%s: read error\n", argv[0]);
+        return 1;
+    }
+
+    Decoder decoder(contents, output);
+    try {
+        if (!decoder.run()) {
+            fprintf(stderr, "%s: input ends in the middle of a record; decoded up to the last complete one\n", argv[0]);
+        }
+    } catch (const Malformed& error) {
+        fprintf(stderr, "%s: malformed input: %s\n", argv[0], error.reason);
+        return 1;
+    }
+    return fclose(output) == 0 ? 0 : 1;
+}
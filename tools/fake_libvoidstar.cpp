@@ -0,0 +1,202 @@
+// A stand-in for the Antithesis runtime library, for exercising and profiling the SDK's Antithesis path
+// locally. It implements the symbols the SDK and antithesis_instrumentation.h look up, keeps the records it is
+// sent in memory, counts calls, and can be slowed down to model the latency of the real runtime.
+// See fake_libvoidstar.h for its configuration and inspection interface.
+
+#include "fake_libvoidstar.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+namespace {
+    constexpr size_t DEFAULT_CAPTURE_BYTES = 64 * 1024 * 1024;
+    constexpr uint64_t SPLITMIX_GAMMA = 0x9E3779B97F4A7C15ull;
+
+    uint64_t get_setting(const char* name, uint64_t default_value) {
+        const char* text = std::getenv(name);
+        if (text == nullptr || !text[0]) {
+            return default_value;
+        }
+        char* end = nullptr;
+        const unsigned long long value = std::strtoull(text, &end, 0);
+        if (*end != '\0') {
+            fprintf(stderr, "fake libvoidstar: invalid value for %s: %s\n", name, text);
+            return default_value;
+        }
+        return static_cast<uint64_t>(value);
+    }
+
+    struct State {
+        std::atomic<uint64_t> json_data_calls{0};
+        std::atomic<uint64_t> json_data_bytes{0};
+        std::atomic<uint64_t> flush_calls{0};
+        std::atomic<uint64_t> get_random_calls{0};
+        std::atomic<uint64_t> pc_guard_init_calls{0};
+        std::atomic<uint64_t> pc_guards{0};
+        std::atomic<uint64_t> pc_guard_calls{0};
+        std::atomic<uint64_t> dropped_records{0};
+
+        std::atomic<uint64_t> latency_ns{get_setting("FAKE_LIBVOIDSTAR_LATENCY_NS", 0)};
+        std::atomic<uint64_t> random_state{get_setting("FAKE_LIBVOIDSTAR_RANDOM_SEED", 0)};
+        // Guard ids handed out so far; 0 is left for guards that were never initialized
+        std::atomic<uint32_t> next_guard{1};
+
+        const size_t capture_bytes = get_setting("FAKE_LIBVOIDSTAR_CAPTURE_BYTES", DEFAULT_CAPTURE_BYTES);
+        std::mutex capture_mutex;
+        std::string captured;
+
+        void delay() const {
+            const uint64_t latency = latency_ns.load(std::memory_order_relaxed);
+            if (latency == 0) {
+                return;
+            }
+            // Spin rather than sleep, since sleeps are far coarser than the latencies being modelled
+            const auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(latency);
+            while (std::chrono::steady_clock::now() < until) {}
+        }
+
+        void capture(const char* message, size_t length) {
+            if (capture_bytes == 0) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(capture_mutex);
+            if (captured.size() + length + 1 > capture_bytes) {
+                dropped_records.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            captured.append(message, length);
+            captured.push_back('\n');
+        }
+
+        // Runs at exit, once the SDK's own exit handlers have flushed everything
+        void report() {
+            const char* path = std::getenv("FAKE_LIBVOIDSTAR_CAPTURE_OUTPUT");
+            if (path != nullptr && path[0]) {
+                FILE* file = fopen(path, "w");
+                if (file == nullptr) {
+                    fprintf(stderr, "fake libvoidstar: cannot open %s: %s\n", path, strerror(errno));
+                } else {
+                    std::lock_guard<std::mutex> lock(capture_mutex);
+                    fwrite(captured.data(), 1, captured.size(), file);
+                    fclose(file);
+                }
+            }
+            if (std::getenv("FAKE_LIBVOIDSTAR_STATS") != nullptr) {
+                fake_libvoidstar_stats stats;
+                fake_libvoidstar_get_stats(&stats);
+                fprintf(stderr,
+                    "fake libvoidstar: %llu fuzz_json_data calls (%llu bytes, %llu records not kept), %llu fuzz_flush calls, "
+                    "%llu fuzz_get_random calls, %llu edge guards in %llu modules, %llu edge hits\n",
+                    static_cast<unsigned long long>(stats.json_data_calls), static_cast<unsigned long long>(stats.json_data_bytes),
+                    static_cast<unsigned long long>(stats.dropped_records), static_cast<unsigned long long>(stats.flush_calls),
+                    static_cast<unsigned long long>(stats.get_random_calls), static_cast<unsigned long long>(stats.pc_guards),
+                    static_cast<unsigned long long>(stats.pc_guard_init_calls), static_cast<unsigned long long>(stats.pc_guard_calls));
+            }
+        }
+    };
+
+    // Leaked rather than destroyed at exit, so that records sent from other exit handlers are still accepted
+    State& get_state() {
+        static State* state = [] {
+            State* created = new State();
+            atexit([] { get_state().report(); });
+            return created;
+        }();
+        return *state;
+    }
+
+    // Created as soon as the library is loaded, so its exit handler runs after those the SDK registers later
+    [[maybe_unused]] State& loaded_state = get_state();
+}
+
+extern "C" {
+    void fuzz_json_data(const char* message, size_t length) {
+        State& state = get_state();
+        state.delay();
+        state.json_data_calls.fetch_add(1, std::memory_order_relaxed);
+        state.json_data_bytes.fetch_add(length, std::memory_order_relaxed);
+        state.capture(message, length);
+    }
+
+    void fuzz_flush() {
+        State& state = get_state();
+        state.delay();
+        state.flush_calls.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t fuzz_get_random() {
+        State& state = get_state();
+        state.delay();
+        state.get_random_calls.fetch_add(1, std::memory_order_relaxed);
+        // splitmix64 over a shared counter, so that values are distinct across threads
+        uint64_t z = state.random_state.fetch_add(SPLITMIX_GAMMA, std::memory_order_relaxed) + SPLITMIX_GAMMA;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Numbers the guards of a module the way the real runtime does, leaving guards that already have an id alone.
+    void __sanitizer_cov_trace_pc_guard_init(uint32_t* start, uint32_t* stop) {
+        State& state = get_state();
+        state.pc_guard_init_calls.fetch_add(1, std::memory_order_relaxed);
+        if (start == stop || *start != 0) {
+            return;
+        }
+        const uint32_t count = static_cast<uint32_t>(stop - start);
+        const uint32_t first = state.next_guard.fetch_add(count, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < count; i++) {
+            start[i] = first + i;
+        }
+        state.pc_guards.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void __sanitizer_cov_trace_pc_guard_internal(uint32_t*, uint64_t) {
+        get_state().pc_guard_calls.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void fake_libvoidstar_get_stats(fake_libvoidstar_stats* stats) {
+        State& state = get_state();
+        stats->json_data_calls = state.json_data_calls.load(std::memory_order_relaxed);
+        stats->json_data_bytes = state.json_data_bytes.load(std::memory_order_relaxed);
+        stats->flush_calls = state.flush_calls.load(std::memory_order_relaxed);
+        stats->get_random_calls = state.get_random_calls.load(std::memory_order_relaxed);
+        stats->pc_guard_init_calls = state.pc_guard_init_calls.load(std::memory_order_relaxed);
+        stats->pc_guards = state.pc_guards.load(std::memory_order_relaxed);
+        stats->pc_guard_calls = state.pc_guard_calls.load(std::memory_order_relaxed);
+        stats->dropped_records = state.dropped_records.load(std::memory_order_relaxed);
+    }
+
+    size_t fake_libvoidstar_copy_captured(char* buffer, size_t capacity) {
+        State& state = get_state();
+        std::lock_guard<std::mutex> lock(state.capture_mutex);
+        memcpy(buffer, state.captured.data(), std::min(capacity, state.captured.size()));
+        return state.captured.size();
+    }
+
+    void fake_libvoidstar_reset(void) {
+        State& state = get_state();
+        {
+            std::lock_guard<std::mutex> lock(state.capture_mutex);
+            state.captured.clear();
+        }
+        state.json_data_calls.store(0, std::memory_order_relaxed);
+        state.json_data_bytes.store(0, std::memory_order_relaxed);
+        state.flush_calls.store(0, std::memory_order_relaxed);
+        state.get_random_calls.store(0, std::memory_order_relaxed);
+        state.pc_guard_init_calls.store(0, std::memory_order_relaxed);
+        state.pc_guards.store(0, std::memory_order_relaxed);
+        state.pc_guard_calls.store(0, std::memory_order_relaxed);
+        state.dropped_records.store(0, std::memory_order_relaxed);
+    }
+
+    void fake_libvoidstar_set_latency(uint64_t nanoseconds) {
+        get_state().latency_ns.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// Inspection interface of the fake libvoidstar (libvoidstar.so built from fake_libvoidstar.cpp). Point the SDK
+// at it with ANTITHESIS_SDK_LIB_PATH to run the emission path taken in Antithesis on a developer machine. A test
+// that links the library, or looks these symbols up with dlsym, can then check what the SDK sent it.
+//
+// It is configured by environment variables, read when it is loaded:
+//   FAKE_LIBVOIDSTAR_CAPTURE_BYTES   records kept in memory, in bytes (default 64 MiB; 0 keeps none)
+//   FAKE_LIBVOIDSTAR_CAPTURE_OUTPUT  file that the kept records are written to at exit, one per line
+//   FAKE_LIBVOIDSTAR_LATENCY_NS      time that every fuzz_* call spins for before returning (default 0)
+//   FAKE_LIBVOIDSTAR_RANDOM_SEED     seed of the values returned by fuzz_get_random (default 0)
+//   FAKE_LIBVOIDSTAR_STATS           if set, the call counters are printed to stderr at exit
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct fake_libvoidstar_stats {
+    uint64_t json_data_calls;
+    uint64_t json_data_bytes;
+    uint64_t flush_calls;
+    uint64_t get_random_calls;
+    uint64_t pc_guard_init_calls;
+    uint64_t pc_guards;
+    uint64_t pc_guard_calls;
+    // Records that did not fit in the capture buffer
+    uint64_t dropped_records;
+};
+
+void fake_libvoidstar_get_stats(struct fake_libvoidstar_stats* stats);
+
+// Copies up to `capacity` bytes of the records captured so far, each followed by a newline, into `buffer`,
+// and returns the number of bytes captured in total.
+size_t fake_libvoidstar_copy_captured(char* buffer, size_t capacity);
+
+// Discards the captured records and zeroes the counters.
+void fake_libvoidstar_reset(void);
+
+// Changes the latency of every fuzz_* call, in nanoseconds.
+void fake_libvoidstar_set_latency(uint64_t nanoseconds);
+
+#ifdef __cplusplus
+}
+#endif
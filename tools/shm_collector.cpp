@@ -0,0 +1,313 @@
+// Drains the shared-memory ring that the SDK writes records into when ANTITHESIS_SDK_LOCAL_OUTPUT_SHM is set,
+// writing them out as JSON lines as soon as they are complete.
+//
+// Usage: antithesis-shm-collector [-s size] [-u] name [output]    (standard output by default)
+//
+// `name` is the same shared-memory name given to the SDK, such as /antithesis-sdk. The ring is created with
+// `size` bytes (ANTITHESIS_SDK_LOCAL_OUTPUT_SHM_SIZE, or 4 MiB, by default) if the SDK hasn't created it yet, so
+// the collector can be started first. It runs until interrupted, then drains what is left, reports records the
+// SDK dropped because the ring was full, and with -u removes the ring.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // Matches SharedRingHeader in antithesis_sdk.h, which documents the layout
+    struct SharedRingHeader {
+        static constexpr uint64_t MAGIC = 0x31474E4952544E41ull; // "ANTRING1"
+        static constexpr uint32_t VERSION = 1;
+
+        std::atomic<uint64_t> magic;
+        uint32_t version;
+        uint32_t header_size;
+        uint64_t capacity;
+        std::atomic<uint64_t> dropped;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+    };
+    static_assert(sizeof(SharedRingHeader) == 192);
+
+    constexpr uint64_t DEFAULT_CAPACITY = 4 * 1024 * 1024;
+    constexpr uint64_t FRAME_HEADER_SIZE = 8;
+    constexpr uint32_t FRAME_COMPLETE = 1;
+    // Bytes of frames released to producers at a time
+    constexpr uint64_t BATCH_BYTES = 256 * 1024;
+    constexpr auto POLL_INTERVAL = std::chrono::milliseconds(1);
+    // How long a frame may stay incomplete before its producer is taken to have died while writing it
+    constexpr auto ABANDONED_AFTER = std::chrono::seconds(1);
+
+    volatile sig_atomic_t stopping = 0;
+
+    constexpr uint64_t frame_size(uint64_t length) {
+        return FRAME_HEADER_SIZE + ((length + 7) & ~uint64_t(7));
+    }
+
+    class Collector {
+    public:
+        Collector(SharedRingHeader* header, FILE* output) :
+            header(header), data(reinterpret_cast<char*>(header) + header->header_size),
+            mask(header->capacity - 1), output(output) {}
+
+        // Frames left incomplete by producers that died while writing them
+        uint64_t abandoned = 0;
+        // Set when a frame claims a length that cannot be in the ring; nothing after it can be trusted
+        bool corrupt = false;
+
+        // Writes out every complete record, returning whether there were any.
+        bool drain() {
+            uint64_t tail = header->tail.load(std::memory_order_relaxed);
+            const uint64_t start = tail;
+            while (!corrupt) {
+                uint64_t batch_start = tail;
+                while (tail - batch_start < BATCH_BYTES) {
+                    const uint64_t offset = tail & mask;
+                    uint32_t* frame = reinterpret_cast<uint32_t*>(data + offset);
+                    if (std::atomic_ref<uint32_t>(frame[1]).load(std::memory_order_acquire) != FRAME_COMPLETE) {
+                        const uint64_t skipped = skip_abandoned(tail);
+                        if (skipped == 0) {
+                            break;
+                        }
+                        tail += skipped;
+                        continue;
+                    }
+                    const uint64_t length = frame[0];
+                    if (length > mask + 1 - FRAME_HEADER_SIZE) {
+                        corrupt = true;
+                        break;
+                    }
+                    copy_out((offset + FRAME_HEADER_SIZE) & mask, length);
+                    records.push_back('\n');
+                    zero(offset, frame_size(length));
+                    tail += frame_size(length);
+                }
+                if (tail == batch_start) {
+                    break;
+                }
+                // Zeroed frames are handed back to producers before the records are written out
+                header->tail.store(tail, std::memory_order_release);
+                fwrite(records.data(), 1, records.size(), output);
+                fflush(output);
+                records.clear();
+            }
+            return tail != start;
+        }
+
+    private:
+        SharedRingHeader* header;
+        char* data;
+        uint64_t mask;
+        FILE* output;
+        std::string records;
+        // When an incomplete frame was last found at the tail, and `head` at that time. Every frame before
+        // `stalled_head` has been reserved since at least `stalled_since`.
+        std::chrono::steady_clock::time_point stalled_since;
+        uint64_t stalled_head = 0;
+
+        // Returns the bytes to skip past the incomplete frame at `tail` once it has been reserved for
+        // ABANDONED_AFTER, which only happens if its producer died between reserving and completing it, and
+        // zeroes them. Returns 0 while the frame may still be completed.
+        uint64_t skip_abandoned(uint64_t tail) {
+            const uint64_t head = header->head.load(std::memory_order_acquire);
+            if (head == tail) {
+                return 0;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (tail >= stalled_head) {
+                stalled_since = now;
+                stalled_head = head;
+                return 0;
+            }
+            if (now - stalled_since < ABANDONED_AFTER) {
+                return 0;
+            }
+
+            const uint64_t offset = tail & mask;
+            const uint64_t length = std::atomic_ref<uint32_t>(*reinterpret_cast<uint32_t*>(data + offset)).load(std::memory_order_relaxed);
+            uint64_t skipped;
+            if (length != 0) {
+                if (length > mask + 1 - FRAME_HEADER_SIZE || frame_size(length) > head - tail) {
+                    corrupt = true;
+                    return 0;
+                }
+                skipped = frame_size(length);
+            } else {
+                // The producer died before writing the length, so wrote nothing at all. Its frame runs up to the
+                // next frame header, the first nonzero word, but no further than the frames that were already
+                // reserved when it stalled, which have all had as long to be written
+                skipped = FRAME_HEADER_SIZE;
+                while (tail + skipped < stalled_head &&
+                       std::atomic_ref<uint64_t>(*reinterpret_cast<uint64_t*>(data + ((tail + skipped) & mask))).load(std::memory_order_relaxed) == 0) {
+                    skipped += FRAME_HEADER_SIZE;
+                }
+            }
+            zero(offset, skipped);
+            abandoned++;
+            return skipped;
+        }
+
+        void copy_out(uint64_t offset, uint64_t length) {
+            const uint64_t first = std::min(length, mask + 1 - offset);
+            records.append(data + offset, first);
+            records.append(data, length - first);
+        }
+
+        void zero(uint64_t offset, uint64_t length) {
+            const uint64_t first = std::min(length, mask + 1 - offset);
+            memset(data + offset, 0, first);
+            memset(data, 0, length - first);
+        }
+    };
+
+    // Maps the ring, creating it the same way the SDK does if it doesn't exist yet.
+    SharedRingHeader* open_ring(const char* program, const char* name, uint64_t capacity) {
+        bool created = true;
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0 && errno == EEXIST) {
+            created = false;
+            fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+        }
+        if (fd < 0) {
+            fprintf(stderr, "%s: cannot open shared memory %s: %s\n", program, name, strerror(errno));
+            return nullptr;
+        }
+        if (created) {
+            if (ftruncate(fd, static_cast<off_t>(sizeof(SharedRingHeader) + capacity)) != 0) {
+                fprintf(stderr, "%s: cannot size shared memory %s: %s\n", program, name, strerror(errno));
+                close(fd);
+                return nullptr;
+            }
+        } else {
+            struct stat stat_buf;
+            for (int attempt = 0;; attempt++) {
+                if (fstat(fd, &stat_buf) != 0) {
+                    fprintf(stderr, "%s: cannot stat shared memory %s: %s\n", program, name, strerror(errno));
+                    close(fd);
+                    return nullptr;
+                }
+                if (stat_buf.st_size > static_cast<off_t>(sizeof(SharedRingHeader)) || attempt >= 1000) break;
+                std::this_thread::sleep_for(POLL_INTERVAL);
+            }
+            capacity = stat_buf.st_size > static_cast<off_t>(sizeof(SharedRingHeader)) ? static_cast<uint64_t>(stat_buf.st_size) - sizeof(SharedRingHeader) : 0;
+            if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+                fprintf(stderr, "%s: shared memory %s does not hold a record ring\n", program, name);
+                close(fd);
+                return nullptr;
+            }
+        }
+
+        void* mapping = mmap(nullptr, sizeof(SharedRingHeader) + capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            fprintf(stderr, "%s: cannot map shared memory %s: %s\n", program, name, strerror(errno));
+            return nullptr;
+        }
+        SharedRingHeader* header = static_cast<SharedRingHeader*>(mapping);
+        if (created) {
+            header->version = SharedRingHeader::VERSION;
+            header->header_size = sizeof(SharedRingHeader);
+            header->capacity = capacity;
+            header->magic.store(SharedRingHeader::MAGIC, std::memory_order_release);
+            return header;
+        }
+        for (int attempt = 0; header->magic.load(std::memory_order_acquire) != SharedRingHeader::MAGIC && attempt < 1000; attempt++) {
+            std::this_thread::sleep_for(POLL_INTERVAL);
+        }
+        if (header->magic.load(std::memory_order_acquire) != SharedRingHeader::MAGIC || header->version != SharedRingHeader::VERSION ||
+            header->header_size != sizeof(SharedRingHeader) || header->capacity != capacity) {
+            fprintf(stderr, "%s: shared memory %s does not hold a record ring\n", program, name);
+            return nullptr;
+        }
+        return header;
+    }
+
+    void usage(const char* program) {
+        fprintf(stderr, "usage: %s [-s size] [-u] name [output]\n", program);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint64_t capacity = DEFAULT_CAPACITY;
+    const char* size = std::getenv("ANTITHESIS_SDK_LOCAL_OUTPUT_SHM_SIZE");
+    if (size && size[0]) {
+        capacity = strtoull(size, nullptr, 0);
+    }
+    bool unlink_at_exit = false;
+    int option;
+    while ((option = getopt(argc, argv, "s:u")) != -1) {
+        switch (option) {
+            case 's': capacity = strtoull(optarg, nullptr, 0); break;
+            case 'u': unlink_at_exit = true; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind >= argc || argc - optind > 2) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (capacity < 4096 || (capacity & (capacity - 1)) != 0) {
+        fprintf(stderr, "%s: the ring size must be a power of two of at least 4096 bytes\n", argv[0]);
+        return 2;
+    }
+    const char* name = argv[optind];
+
+    FILE* output = stdout;
+    if (argc - optind == 2) {
+        output = fopen(argv[optind + 1], "w");
+        if (output == nullptr) {
+            fprintf(stderr, "%s: cannot open %s: %s\n", argv[0], argv[optind + 1], strerror(errno));
+            return 1;
+        }
+    }
+
+    SharedRingHeader* header = open_ring(argv[0], name, capacity);
+    if (header == nullptr) {
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = [](int) { stopping = 1; };
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    Collector collector(header, output);
+    while (!stopping && !collector.corrupt) {
+        if (!collector.drain()) {
+            std::this_thread::sleep_for(POLL_INTERVAL);
+        }
+    }
+    collector.drain();
+
+    if (collector.abandoned > 0) {
+        fprintf(stderr, "%s: skipped %llu frames left incomplete by processes that died while writing them\n", argv[0], static_cast<unsigned long long>(collector.abandoned));
+    }
+    const uint64_t dropped = header->dropped.load(std::memory_order_relaxed);
+    if (dropped > 0) {
+        fprintf(stderr, "%s: the SDK dropped %llu records because the ring was full\n", argv[0], static_cast<unsigned long long>(dropped));
+    }
+    if (unlink_at_exit) {
+        shm_unlink(name);
+    }
+    if (output != stdout) {
+        fclose(output);
+    }
+    if (collector.corrupt) {
+        fprintf(stderr, "%s: the ring holds a frame longer than the ring itself; it is corrupt\n", argv[0]);
+        return 1;
+    }
+    return 0;
+}